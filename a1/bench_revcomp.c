@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "seqbot_revcomp.h"
+
+/* Time reverse-complementing (genfile mode 3) a SEQ_LEN base sequence with
+ * the copy-based reverse() and if-chain complement() that genfile used to
+ * have, and with each transform kernel this CPU supports.
+ */
+
+#define SEQ_LEN (1 << 20)
+#define ROUNDS 200
+
+static char seq[SEQ_LEN];
+
+static void old_reverse(char *sequence, int sequence_length)
+{
+    char sequence_org[sequence_length];
+    for (int j = 0; j < sequence_length; j++) {
+        sequence_org[j] = sequence[j];
+    }
+    for (int j = 0; j < sequence_length; j++) {
+        sequence[j] = sequence_org[sequence_length - j - 1];
+    }
+}
+
+static void old_complement(char *sequence, int sequence_length)
+{
+    for (int j = 0; j < sequence_length; j++){
+        if (sequence[j] == 'A'){
+            sequence[j] = 'T';
+        }
+        else if (sequence[j] == 'T'){
+            sequence[j] = 'A';
+        }
+        else if (sequence[j] == 'C'){
+            sequence[j] = 'G';
+        }
+        else if (sequence[j] == 'G'){
+            sequence[j] = 'C';
+        }
+    }
+}
+
+static void old_transform(char *sequence, int sequence_length, int mode)
+{
+    if (mode % 2 == 1){
+        old_complement(sequence, sequence_length);
+    }
+    if (mode >= 2){
+        old_reverse(sequence, sequence_length);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Print the time per call and throughput of kernel on seq.
+ */
+static void bench(const char *name, transform_fn kernel)
+{
+    double start = now();
+    for (int r = 0; r < ROUNDS; r++){
+        kernel(seq, SEQ_LEN, 3);
+    }
+    double elapsed = now() - start;
+    printf("%-10s %8.1f us/call %8.2f GB/s\n", name,
+           elapsed / ROUNDS * 1e6, (double)SEQ_LEN * ROUNDS / elapsed / 1e9);
+}
+
+int main(void)
+{
+    srand(209);
+    for (int i = 0; i < SEQ_LEN; i++){
+        seq[i] = "ACGT"[rand() % 4];
+    }
+    printf("reverse complement of %d bases, %d rounds\n", SEQ_LEN, ROUNDS);
+    bench("old", old_transform);
+    bench("scalar", transform_scalar);
+#ifdef SEQBOT_X86
+    if (cpu_has_ssse3()){
+        bench("ssse3", transform_ssse3);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "seqbot_helpers.h"
+#include "seqbot_nn.h"
+
+/* Benchmarks for melt, print, genall, genfile and kmers.
+ *
+ * Every dataset is generated from a fixed seed, so two builds are measured
+ * on exactly the same input. Each case runs in its own child process with
+ * standard output sent to /dev/null, so its peak RSS can be read with wait4
+ * and one case cannot affect the next.
+ *
+ * The results are written to standard output as CSV, one line per case:
+ *     task,case,seconds,bases_per_s,lines_per_s,peak_rss_kb
+ * A line is a molecule: a record read by genfile or written by genall, or
+ * one sequence for melt and print. A summary is written to standard error.
+ *
+ * Usage: bench_seqbot [-q]   (-q runs smaller datasets, for a quick check)
+ */
+
+// the most molecules in a melt or print case, and the bases they add up to
+#define MAX_REPEATS 100000
+#define PRINT_BASES (1L << 24)
+
+static unsigned long long rng_state = 209;
+static int quick = 0;
+
+/* xorshift64*: the same sequence of numbers on every platform.
+ */
+static unsigned long long next_random(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+/* Fill sequence with length random bases.
+ */
+static void random_bases(char *sequence, long length)
+{
+    for (long i = 0; i < length; i++){
+        sequence[i] = "ACGT"[next_random() >> 62];
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The work of one case, run in the child. arg is passed through.
+ */
+typedef void (*bench_fn)(void *arg);
+
+/* Run fn(arg) in a child process with stdout on /dev/null, and report the
+ * time it took and its peak RSS. bases and lines are the amount of work
+ * the case does, used for the throughput columns. Return the time taken.
+ */
+static double run_case(const char *task, const char *name, bench_fn fn, void *arg,
+                     double bases, double lines)
+{
+    struct rusage usage;
+    double start;
+    double elapsed;
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    start = now();
+    pid = fork();
+    if (pid < 0){
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+        if (null < 0){
+            perror("/dev/null");
+            exit(1);
+        }
+        dup2(null, STDOUT_FILENO);
+        fn(arg);
+        fflush(stdout);
+        _exit(0);
+    }
+    if (wait4(pid, &status, 0, &usage) < 0){
+        perror("wait4");
+        exit(1);
+    }
+    elapsed = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        fprintf(stderr, "%s %s failed\n", task, name);
+        exit(1);
+    }
+    printf("%s,%s,%.6f,%.0f,%.0f,%ld\n", task, name, elapsed,
+           bases / elapsed, lines / elapsed, usage.ru_maxrss);
+    fprintf(stderr, "%-8s %-22s %8.3f s %10.1f Mbases/s %10.3f Mlines/s %8ld KB\n",
+            task, name, elapsed, bases / elapsed / 1e6, lines / elapsed / 1e6,
+            usage.ru_maxrss);
+    return elapsed;
+}
+
+/* A sequence and how many times to process it.
+ */
+struct sequence_case {
+    char *sequence;
+    long length;
+    long repeats;
+};
+
+static void melt_case(void *arg)
+{
+    struct sequence_case *c = arg;
+    volatile int sink = 0;
+    for (long r = 0; r < c->repeats; r++){
+        sink += calculate_melting_temperature(c->sequence, c->length);
+    }
+}
+
+static void melt_nn_case(void *arg)
+{
+    struct sequence_case *c = arg;
+    volatile double sink = 0;
+    double temperature;
+    for (long r = 0; r < c->repeats; r++){
+        nn_melting_temperature(c->sequence, c->length, &temperature);
+        sink += temperature;
+    }
+}
+
+static void print_case(void *arg)
+{
+    struct sequence_case *c = arg;
+    for (long r = 0; r < c->repeats; r++){
+        print_instructions(c->sequence, c->length);
+    }
+}
+
+/* Time melt with both models and print on random sequences of several lengths. Each
+ * length is repeated so that every case covers about PRINT_BASES bases.
+ */
+static void bench_sequences(void)
+{
+    const long lengths[] = {16, 256, 4096, 1L << 20};
+    struct sequence_case c;
+    char name[32];
+    long total = quick ? PRINT_BASES / 16 : PRINT_BASES;
+
+    for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++){
+        c.length = lengths[i];
+        c.repeats = total / c.length;
+        if (c.repeats > MAX_REPEATS){
+            c.repeats = MAX_REPEATS;
+        }
+        if (c.repeats < 1){
+            c.repeats = 1;
+        }
+        c.sequence = malloc(c.length);
+        if (c.sequence == NULL){
+            perror("malloc");
+            exit(1);
+        }
+        random_bases(c.sequence, c.length);
+        snprintf(name, sizeof(name), "len=%ld", c.length);
+        run_case("melt", name, melt_case, &c,
+                 (double)c.length * c.repeats, c.repeats);
+        run_case("melt_nn", name, melt_nn_case, &c,
+                 (double)c.length * c.repeats, c.repeats);
+        run_case("print", name, print_case, &c,
+                 (double)c.length * c.repeats, c.repeats);
+        free(c.sequence);
+    }
+}
+
+/* A genall run.
+ */
+struct genall_case {
+    int k;
+    struct genall_options opts;
+};
+
+static void genall_case(void *arg)
+{
+    struct genall_case *c = arg;
+    generate_all_molecules_with_options(c->k, &c->opts);
+}
+
+/* Time genall for several k, with one thread and with four.
+ */
+static void bench_genall(void)
+{
+    const int ks[] = {8, 10, 12};
+    const int threads[] = {1, 4};
+    struct genall_case c;
+    char name[32];
+    double lines;
+
+    for (int i = 0; i < (int)(sizeof(ks) / sizeof(ks[0])); i++){
+        c.k = quick ? ks[i] - 2 : ks[i];
+        lines = (double)(1L << (2 * c.k));
+        for (int t = 0; t < 2; t++){
+            c.opts = (struct genall_options){.num_threads = threads[t],
+                                             .format = FORMAT_TEXT,
+                                             .tm_max = INT_MAX,
+                                             .shard = 1, .num_shards = 1};
+            snprintf(name, sizeof(name), "k=%d j=%d", c.k, threads[t]);
+            run_case("genall", name, genall_case, &c, lines * c.k, lines);
+        }
+    }
+}
+
+/* A genfile run over a generated file.
+ */
+struct genfile_case {
+    char *filename;
+    struct genfile_options opts;
+};
+
+static void genfile_case(void *arg)
+{
+    struct genfile_case *c = arg;
+    generate_molecules_from_file_with_options(c->filename, &c->opts);
+}
+
+/* Write a genfile input of num_records records to a new temporary file, with
+ * lengths from min_len to max_len and random modes, or as FASTA wrapped at
+ * 80 bases. Return the name of the file and set *bases to its total bases.
+ */
+static char *write_genfile_input(long num_records, long min_len, long max_len,
+                                 int fasta, double *bases)
+{
+    char *filename = strdup("/tmp/seqbot_bench_XXXXXX");
+    char *sequence = malloc(max_len);
+    long length;
+    FILE *fp;
+    int fd;
+
+    if (filename == NULL || sequence == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    fd = mkstemp(filename);
+    if (fd < 0 || (fp = fdopen(fd, "w")) == NULL){
+        perror("mkstemp");
+        exit(1);
+    }
+    *bases = 0;
+    for (long r = 0; r < num_records; r++){
+        length = min_len + next_random() % (max_len - min_len + 1);
+        random_bases(sequence, length);
+        *bases += length;
+        if (fasta){
+            fprintf(fp, ">record%ld\n", r);
+            for (long i = 0; i < length; i += 80){
+                fwrite(sequence + i, 1, length - i < 80 ? length - i : 80, fp);
+                fputc('\n', fp);
+            }
+        }
+        else {
+            fprintf(fp, "%ld %.*s %d\n", length, (int)length, sequence,
+                    (int)(next_random() >> 62));
+        }
+    }
+    fclose(fp);
+    free(sequence);
+    return filename;
+}
+
+/* Time genfile on short records, long records and wrapped FASTA, each with
+ * one thread and with four.
+ */
+static void bench_genfile(void)
+{
+    struct {
+        const char *name;
+        long records;
+        long min_len;
+        long max_len;
+        int fasta;
+    } inputs[] = {
+        {"short", 1000000, 1, 100, 0},
+        {"long", 2000, 1000, 20000, 0},
+        {"fasta", 2000, 1000, 20000, 1}
+    };
+    const int threads[] = {1, 4};
+    struct genfile_case c;
+    char name[32];
+    double bases;
+    long records;
+
+    for (int i = 0; i < (int)(sizeof(inputs) / sizeof(inputs[0])); i++){
+        records = quick ? inputs[i].records / 10 : inputs[i].records;
+        c.filename = write_genfile_input(records, inputs[i].min_len,
+                                         inputs[i].max_len, inputs[i].fasta, &bases);
+        for (int t = 0; t < 2; t++){
+            c.opts = (struct genfile_options){.num_threads = threads[t],
+                                              .format = FORMAT_TEXT,
+                                              .default_mode = 3};
+            snprintf(name, sizeof(name), "%s j=%d", inputs[i].name, threads[t]);
+            run_case("genfile", name, genfile_case, &c, bases, records);
+        }
+        unlink(c.filename);
+        free(c.filename);
+    }
+}
+
+/* A kmers run over a generated file.
+ */
+struct kmers_case {
+    int k;
+    char *filename;
+    struct kmer_options opts;
+};
+
+static void kmers_case(void *arg)
+{
+    struct kmers_case *c = arg;
+    count_kmers(c->k, c->filename, &c->opts);
+}
+
+/* Time kmers with k = 21 on a FASTA file, printing every k-mer and only
+ * the 100 most frequent, with 1, 2, 4 and 8 threads. The summary also
+ * gives the speedup of each over one thread.
+ */
+static void bench_kmers(void)
+{
+    const int threads[] = {1, 2, 4, 8};
+    const long tops[] = {0, 100};
+    struct kmers_case c;
+    char name[32];
+    double bases;
+    double elapsed;
+    double serial = 0;
+    long records = quick ? 100 : 1000;
+
+    c.k = 21;
+    c.filename = write_genfile_input(records, 1000, 20000, 1, &bases);
+    for (int n = 0; n < 2; n++){
+        for (int t = 0; t < 4; t++){
+            c.opts = (struct kmer_options){.num_threads = threads[t],
+                                           .top = tops[n]};
+            snprintf(name, sizeof(name), "k=21 n=%ld j=%d", tops[n], threads[t]);
+            elapsed = run_case("kmers", name, kmers_case, &c, bases, records);
+            if (t == 0){
+                serial = elapsed;
+                continue;
+            }
+            fprintf(stderr, "%-8s %-22s %8.2fx the speed of j=1\n", "kmers", name,
+                    serial / elapsed);
+        }
+    }
+    unlink(c.filename);
+    free(c.filename);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-q") == 0){
+        quick = 1;
+    }
+    else if (argc > 1){
+        fprintf(stderr, "usage: bench_seqbot [-q]\n");
+        return 1;
+    }
+    printf("task,case,seconds,bases_per_s,lines_per_s,peak_rss_kb\n");
+    bench_sequences();
+    bench_genall();
+    bench_genfile();
+    bench_kmers();
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+#include "seqbot_batch.h"
+#include "seqbot_melt.h"
+#include "seqbot_nn.h"
+#include "seqbot_render.h"
+
+/* Return sequence i of batch in *sequence and its length, or -1 if it is
+ * too long for the kernels, which take an int length.
+ */
+static int batch_sequence(const struct seqbot_batch *batch, size_t i,
+                          const char **sequence)
+{
+    size_t length = batch->offsets[i + 1] - batch->offsets[i];
+
+    *sequence = batch->arena + batch->offsets[i];
+    return length > INT_MAX ? -1 : (int)length;
+}
+
+/* Return the most bytes the instructions for a sequence of length bases
+ * can take in format, counting the space the render kernels reserve
+ * beyond what they write.
+ *
+ * In text a run of r bases is "WRITE b r\n", at most 10r bytes, and the
+ * START, SET_TEMPERATURE and END lines with the slack of the last
+ * reservation fit in 60 more. In binary a run takes at most one byte per
+ * base, and the rest with its slack fits in 32. Both cover the
+ * instructions of an invalid sequence.
+ */
+static size_t instructions_bound(size_t length, enum output_format format)
+{
+    if (format == FORMAT_BIN){
+        return length + 32;
+    }
+    return 10 * length + 60;
+}
+
+/* Set temperatures[i] to the melting temperature of sequence i of batch,
+ * or -1 if it is invalid, as calculate_melting_temperature does.
+ */
+void batch_melting_temperatures(const struct seqbot_batch *batch,
+                                int *temperatures)
+{
+    const char *sequence;
+    int length;
+
+    for (size_t i = 0; i < batch->count; i++){
+        length = batch_sequence(batch, i, &sequence);
+        temperatures[i] = length < 0 ? -1 : fast_melting_temperature(sequence, length);
+    }
+}
+
+/* Set temperatures[i] to the melting temperature of sequence i of batch by
+ * the nearest-neighbor model of nn_melting_temperature, or to NAN if it is
+ * invalid there, since a valid temperature can be negative.
+ */
+void batch_nn_melting_temperatures(const struct seqbot_batch *batch,
+                                   double *temperatures)
+{
+    const char *sequence;
+    int length;
+
+    for (size_t i = 0; i < batch->count; i++){
+        length = batch_sequence(batch, i, &sequence);
+        if (length < 0 || nn_melting_temperature(sequence, length, &temperatures[i]) < 0){
+            temperatures[i] = NAN;
+        }
+    }
+}
+
+/* Set valid[i] to 1 if sequence i of batch is not empty and holds only
+ * 'A', 'C', 'G' and 'T', or to 0 otherwise.
+ */
+void batch_validate(const struct seqbot_batch *batch, unsigned char *valid)
+{
+    const char *sequence;
+    int length;
+
+    for (size_t i = 0; i < batch->count; i++){
+        length = batch_sequence(batch, i, &sequence);
+        valid[i] = length >= 0 && fast_melting_temperature(sequence, length) >= 0;
+    }
+}
+
+/* Return the number of bytes of out that batch_render_instructions needs
+ * to be sure of rendering all of batch in format.
+ */
+size_t batch_instructions_bound(const struct seqbot_batch *batch,
+                                enum output_format format)
+{
+    size_t bound = 0;
+
+    for (size_t i = 0; i < batch->count; i++){
+        bound += instructions_bound(batch->offsets[i + 1] - batch->offsets[i],
+                                    format);
+    }
+    return bound;
+}
+
+/* Render the instructions for the sequences of batch one after another
+ * into the capacity bytes at out, as print_instructions_with_format writes
+ * them without BIN_MAGIC. An invalid sequence is rendered by
+ * render_invalid, as print_instructions has always printed it.
+ *
+ * The instructions for sequence i are the bytes of out from out_offsets[i]
+ * to out_offsets[i + 1], and if temperatures is not NULL,
+ * temperatures[i] is set to its melting temperature or -1.
+ *
+ * Rendering stops before the first sequence that might not fit in what is
+ * left of out, so the kernels never run out of room; if they did, out is
+ * not grown and the program exits. Return the number of sequences rendered, which is
+ * batch->count when capacity is at least batch_instructions_bound.
+ * out_offsets needs one more entry than that.
+ */
+size_t batch_render_instructions(const struct seqbot_batch *batch,
+                                 enum output_format format,
+                                 char *out, size_t capacity,
+                                 size_t *out_offsets, int *temperatures)
+{
+    // the kernels append to an out_buf; this one is never grown
+    struct out_buf buf = {.data = out, .len = 0, .capacity = capacity, .fixed = 1};
+    const char *sequence;
+    int length;
+    int temperature;
+    size_t i;
+
+    out_offsets[0] = 0;
+    for (i = 0; i < batch->count; i++){
+        length = batch_sequence(batch, i, &sequence);
+        if (instructions_bound(batch->offsets[i + 1] - batch->offsets[i], format)
+            > capacity - buf.len){
+            break;
+        }
+        temperature = length < 0 ? -1 : render_instructions(&buf, sequence,
+                                                             length, format);
+        if (temperature < 0){
+            render_invalid(&buf, sequence, length, format);
+        }
+        if (temperatures != NULL){
+            temperatures[i] = temperature;
+        }
+        out_offsets[i + 1] = buf.len;
+    }
+    return i;
+}
@@ -0,0 +1,42 @@
+#ifndef SEQBOT_BATCH
+#define SEQBOT_BATCH
+
+#include <stddef.h>
+#include "seqbot_output.h"
+
+/* Entry points of libseqbot that work on many sequences per call, for
+ * programs that link the library instead of running seqbot. Results go
+ * into arrays the caller provides, and nothing is allocated per sequence.
+ */
+
+/* A batch of sequences stored back to back in one arena.
+ *   - sequence i is the offsets[i + 1] - offsets[i] bytes at
+ *     arena + offsets[i], so offsets holds count + 1 entries
+ *   - the sequences are not NUL terminated, and the arena is only read
+ * The offsets are from the start of the arena, so the last count - n
+ * sequences are the batch {arena, offsets + n, count - n}.
+ */
+struct seqbot_batch {
+    const char *arena;
+    const size_t *offsets;
+    size_t count;
+};
+
+// the melting temperature of each sequence, or -1 where it is invalid
+void batch_melting_temperatures(const struct seqbot_batch *batch,
+                                int *temperatures);
+// the nearest-neighbor melting temperature of each sequence, or NAN
+void batch_nn_melting_temperatures(const struct seqbot_batch *batch,
+                                   double *temperatures);
+// 1 for each sequence of only 'A', 'C', 'G' and 'T', 0 for the others
+void batch_validate(const struct seqbot_batch *batch, unsigned char *valid);
+// the most bytes batch_render_instructions can need for the whole batch
+size_t batch_instructions_bound(const struct seqbot_batch *batch,
+                                enum output_format format);
+// render the instructions of the sequences into out, as many as fit
+size_t batch_render_instructions(const struct seqbot_batch *batch,
+                                 enum output_format format,
+                                 char *out, size_t capacity,
+                                 size_t *out_offsets, int *temperatures);
+
+#endif
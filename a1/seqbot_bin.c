@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seqbot_bin.h"
+
+static const char base_letter[4] = {'A', 'C', 'G', 'T'};
+
+/* Append a varint holding value to out.
+ */
+static void append_varint(struct out_buf *out, unsigned long value)
+{
+    char *p = reserve_out_buf(out, 10);
+    int n = 0;
+    while (value >= 0x80){
+        p[n++] = (char)(0x80 | (value & 0x7F));
+        value >>= 7;
+    }
+    p[n++] = (char)value;
+    out->len += n;
+}
+
+/* Append the WRITE of run bases of 2-bit code to out.
+ */
+void append_bin_write(struct out_buf *out, int code, long run)
+{
+    char *p = reserve_out_buf(out, 1);
+    if (run < BIN_WRITE_LONG_RUN){
+        *p = (char)(BIN_WRITE | code << 5 | run);
+        out->len++;
+        return;
+    }
+    *p = (char)(BIN_WRITE | code << 5 | BIN_WRITE_LONG_RUN);
+    out->len++;
+    append_varint(out, run - BIN_WRITE_LONG_RUN);
+}
+
+void append_bin_temperature(struct out_buf *out, long temperature)
+{
+    char *p = reserve_out_buf(out, 1);
+    *p = BIN_SET_TEMPERATURE;
+    out->len++;
+    append_varint(out, temperature);
+}
+
+/* Read a varint from in into value.
+ * Return 0 on success or -1 if the stream ends or the number is too long.
+ */
+static int read_varint(FILE *in, unsigned long *value)
+{
+    int c;
+    int shift = 0;
+
+    *value = 0;
+    do {
+        c = getc_unlocked(in);
+        if (c == EOF || shift > 56){
+            return -1;
+        }
+        *value |= (unsigned long)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return 0;
+}
+
+/* Convert the binary instruction stream in into the text instructions,
+ * written to fd. Return 0 on success, or -1 if in is not a valid stream;
+ * the text for everything before the error has then been written.
+ */
+int decode_instructions(FILE *in, int fd)
+{
+    struct out_buf out;
+    char magic[BIN_MAGIC_LEN];
+    unsigned long n;
+    int in_molecule = 0;
+    int ret = 0;
+    int c;
+
+    if (fread(magic, 1, BIN_MAGIC_LEN, in) != BIN_MAGIC_LEN
+        || memcmp(magic, BIN_MAGIC, BIN_MAGIC_LEN) != 0){
+        return -1;
+    }
+    init_out_buf(&out);
+    while ((c = getc_unlocked(in)) != EOF){
+        if (c & BIN_WRITE){
+            n = c & BIN_WRITE_LONG_RUN;
+            if (n == BIN_WRITE_LONG_RUN){
+                unsigned long extra;
+                if (read_varint(in, &extra) != 0){
+                    ret = -1;
+                    break;
+                }
+                n += extra;
+            }
+            append_out_buf(&out, "WRITE ", 6);
+            append_out_buf(&out, &base_letter[(c >> 5) & 3], 1);
+            append_out_buf(&out, " ", 1);
+            append_int_out_buf(&out, n);
+            append_out_buf(&out, "\n", 1);
+        }
+        else if (c == BIN_START){
+            append_out_buf(&out, "START\n", 6);
+            in_molecule = 1;
+        }
+        else if (c == BIN_SET_TEMPERATURE){
+            if (read_varint(in, &n) != 0){
+                ret = -1;
+                break;
+            }
+            append_out_buf(&out, "SET_TEMPERATURE ", 16);
+            append_int_out_buf(&out, n);
+            append_out_buf(&out, "\n", 1);
+        }
+        else if (c == BIN_END){
+            append_out_buf(&out, "END\n", 4);
+            in_molecule = 0;
+        }
+        else if (c == BIN_INVALID){
+            append_out_buf(&out, "INVALID SEQUENCE\n", in_molecule ? 17 : 16);
+            in_molecule = 0;
+        }
+        else {
+            ret = -1;
+            break;
+        }
+        if (out.len >= (1 << 16)){
+            flush_out_buf(&out, fd);
+        }
+    }
+    flush_out_buf(&out, fd);
+    free_out_buf(&out);
+    return ret;
+}
@@ -0,0 +1,43 @@
+#ifndef SEQBOT_BIN
+#define SEQBOT_BIN
+
+#include <stdio.h>
+#include "seqbot_output.h"
+
+/* The binary instruction stream written with --format=bin.
+ *
+ * A stream starts with the 4 bytes BIN_MAGIC, followed by one opcode byte
+ * per instruction:
+ *   - BIN_START (0x01)            START
+ *   - BIN_SET_TEMPERATURE (0x02)  SET_TEMPERATURE, followed by the
+ *                                 temperature as a varint
+ *   - BIN_END (0x03)              END
+ *   - BIN_INVALID (0x04)          INVALID SEQUENCE
+ *   - 1bbrrrrr (0x80 - 0xFF)      WRITE of base bb (0 A, 1 C, 2 G, 3 T)
+ *                                 with run length rrrrr. If rrrrr is 31
+ *                                 the run is 31 plus a varint that follows.
+ * A varint is an unsigned number in groups of 7 bits, lowest group first,
+ * with the top bit of each byte set if another byte follows.
+ *
+ * A run of up to 30 bases takes one byte instead of the 10 or more of
+ * "WRITE A 12\n". INVALID SEQUENCE between START and END decodes with a
+ * newline, as print writes it; anywhere else it ends the stream without
+ * one, as genfile writes it.
+ */
+
+#define BIN_MAGIC "SQB\001"
+#define BIN_MAGIC_LEN 4
+
+#define BIN_START 0x01
+#define BIN_SET_TEMPERATURE 0x02
+#define BIN_END 0x03
+#define BIN_INVALID 0x04
+#define BIN_WRITE 0x80
+#define BIN_WRITE_LONG_RUN 31
+
+void append_bin_write(struct out_buf *out, int code, long run);
+void append_bin_temperature(struct out_buf *out, long temperature);
+
+int decode_instructions(FILE *in, int fd);
+
+#endif
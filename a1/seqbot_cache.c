@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "seqbot_cache.h"
+#include "seqbot_render.h"
+#include "seqbot_packed.h"
+
+// longer sequences are rendered without the cache; they rarely repeat
+#define CACHE_MAX_KEY 4096
+#define CACHE_KEY_WORDS PACKED_WORDS(CACHE_MAX_KEY)
+// the hash table starts with one bucket for each this many bytes of capacity
+#define CACHE_BYTES_PER_BUCKET 256
+
+/* One cached sequence and its rendered instructions.
+ *   - data holds the words of the key_len bases of the sequence, packed,
+ *     followed by the out_len bytes of output
+ *   - prev and next link the entries from most to least recently used
+ *   - chain links the entries of one hash bucket
+ */
+struct cache_entry {
+    uint64_t hash;
+    int key_len;
+    int temperature;
+    size_t out_len;
+    struct cache_entry *prev;
+    struct cache_entry *next;
+    struct cache_entry *chain;
+    char data[];
+};
+
+/* The cache and its counters.
+ *   - buckets is a table of num_buckets chains, num_buckets a power of 2
+ *   - newest and oldest are the ends of the LRU list
+ *   - size is the number of bytes held by the entries
+ *   - format is the format of the cached output
+ */
+struct render_cache {
+    struct cache_entry **buckets;
+    size_t num_buckets;
+    struct cache_entry *newest;
+    struct cache_entry *oldest;
+    size_t size;
+    size_t capacity;
+    long hits;
+    long misses;
+    long evictions;
+    enum output_format format;
+    pthread_mutex_t lock;
+};
+
+/* Create a cache of at most capacity bytes for output in format.
+ */
+struct render_cache *create_render_cache(size_t capacity, enum output_format format)
+{
+    struct render_cache *cache = malloc(sizeof(struct render_cache));
+    size_t num_buckets = 1024;
+
+    while (num_buckets < capacity / CACHE_BYTES_PER_BUCKET){
+        num_buckets *= 2;
+    }
+    if (cache != NULL){
+        cache->buckets = calloc(num_buckets, sizeof(struct cache_entry *));
+    }
+    if (cache == NULL || cache->buckets == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    cache->num_buckets = num_buckets;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->size = 0;
+    cache->capacity = capacity;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->format = format;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void free_render_cache(struct render_cache *cache)
+{
+    struct cache_entry *entry = cache->newest;
+    struct cache_entry *next;
+
+    while (entry != NULL){
+        next = entry->next;
+        free(entry);
+        entry = next;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+// the number of bytes of data that hold a key of length bases
+static size_t key_size(int length)
+{
+    return PACKED_WORDS(length) * sizeof(uint64_t);
+}
+
+/* Hash the packed key a word, or 32 bases, at a time, finishing with the
+ * splitmix64 mixer so that every bit of the result depends on the input.
+ */
+static uint64_t hash_key(struct packed_seq *key)
+{
+    uint64_t hash = (uint64_t)key->length * 0x9e3779b97f4a7c15ULL;
+
+    for (int w = 0; w < PACKED_WORDS(key->length); w++){
+        hash = (hash ^ key->words[w]) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+static size_t entry_size(struct cache_entry *entry)
+{
+    return sizeof(struct cache_entry) + key_size(entry->key_len) + entry->out_len;
+}
+
+/* Return the link to the entry for the packed key of length bases in
+ * words, or to the NULL at the end of its chain if there is none.
+ */
+static struct cache_entry **find_entry(struct render_cache *cache, uint64_t hash,
+                                       const void *words, int length)
+{
+    struct cache_entry **link = &cache->buckets[hash & (cache->num_buckets - 1)];
+    while (*link != NULL){
+        if ((*link)->hash == hash && (*link)->key_len == length
+            && memcmp((*link)->data, words, key_size(length)) == 0){
+            break;
+        }
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+static void unlink_entry(struct render_cache *cache, struct cache_entry *entry)
+{
+    if (entry->prev != NULL){
+        entry->prev->next = entry->next;
+    }
+    else {
+        cache->newest = entry->next;
+    }
+    if (entry->next != NULL){
+        entry->next->prev = entry->prev;
+    }
+    else {
+        cache->oldest = entry->prev;
+    }
+}
+
+static void push_entry(struct render_cache *cache, struct cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->newest;
+    if (cache->newest != NULL){
+        cache->newest->prev = entry;
+    }
+    else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+/* Remove the least recently used entry from the list and its bucket.
+ */
+static void evict_oldest(struct render_cache *cache)
+{
+    struct cache_entry *entry = cache->oldest;
+    struct cache_entry **link = find_entry(cache, entry->hash, entry->data,
+                                           entry->key_len);
+    *link = entry->chain;
+    unlink_entry(cache, entry);
+    cache->size -= entry_size(entry);
+    cache->evictions++;
+    free(entry);
+}
+
+/* Add the out_len bytes of output rendered from the sequence packed in
+ * key, evicting old entries until it fits. Another thread may have added
+ * the same sequence while this one was rendering it, in which case nothing
+ * is added. The lock must be held.
+ */
+static void insert_entry(struct render_cache *cache, uint64_t hash,
+                         struct packed_seq *key,
+                         const char *output, size_t out_len, int temperature)
+{
+    size_t size = sizeof(struct cache_entry) + key_size(key->length) + out_len;
+    struct cache_entry *entry;
+
+    if (size > cache->capacity
+        || *find_entry(cache, hash, key->words, key->length) != NULL){
+        return;
+    }
+    while (cache->size + size > cache->capacity){
+        evict_oldest(cache);
+    }
+    entry = malloc(size);
+    if (entry == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    entry->hash = hash;
+    entry->key_len = key->length;
+    entry->temperature = temperature;
+    entry->out_len = out_len;
+    memcpy(entry->data, key->words, key_size(key->length));
+    memcpy(entry->data + key_size(key->length), output, out_len);
+    entry->chain = cache->buckets[hash & (cache->num_buckets - 1)];
+    cache->buckets[hash & (cache->num_buckets - 1)] = entry;
+    push_entry(cache, entry);
+    cache->size += size;
+}
+
+/* Append the instructions for sequence to out as render_instructions
+ * does. A sequence seen before has its output copied from the cache;
+ * any other valid sequence is rendered and then added to the cache.
+ * The sequence is looked up packed, so the keys take a quarter of the
+ * bytes of the sequences and are hashed and compared 32 bases at a time.
+ * Invalid sequences, which cannot be packed, are not cached, and neither
+ * are sequences longer than CACHE_MAX_KEY or rendered in another format
+ * than the cache holds. With cache NULL this is just render_instructions.
+ */
+int render_cached(struct render_cache *cache, struct out_buf *out,
+                  const char *sequence, int sequence_length,
+                  enum output_format format)
+{
+    uint64_t key_words[CACHE_KEY_WORDS];
+    struct packed_seq key = {.length = 0, .capacity = CACHE_KEY_WORDS, .words = key_words};
+    struct cache_entry *entry = NULL;
+    uint64_t hash = 0;
+    size_t start = out->len;
+    int valid;
+    int temperature;
+
+    if (cache == NULL || sequence_length > CACHE_MAX_KEY || format != cache->format){
+        return render_instructions(out, sequence, sequence_length, format);
+    }
+    valid = encode_sequence(sequence, sequence_length, &key) == 0;
+    if (valid){
+        hash = hash_key(&key);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (valid){
+        entry = *find_entry(cache, hash, key.words, key.length);
+    }
+    if (entry != NULL){
+        unlink_entry(cache, entry);
+        push_entry(cache, entry);
+        append_out_buf(out, entry->data + key_size(entry->key_len), entry->out_len);
+        temperature = entry->temperature;
+        cache->hits++;
+        pthread_mutex_unlock(&cache->lock);
+        return temperature;
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    temperature = render_instructions(out, sequence, sequence_length, format);
+    if (temperature < 0){
+        return temperature;
+    }
+    pthread_mutex_lock(&cache->lock);
+    insert_entry(cache, hash, &key, out->data + start, out->len - start, temperature);
+    pthread_mutex_unlock(&cache->lock);
+    return temperature;
+}
+
+void report_render_cache(struct render_cache *cache, FILE *fp)
+{
+    pthread_mutex_lock(&cache->lock);
+    fprintf(fp, "cache: %ld hits, %ld misses, %ld evictions\n",
+            cache->hits, cache->misses, cache->evictions);
+    pthread_mutex_unlock(&cache->lock);
+}
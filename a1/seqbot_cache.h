@@ -0,0 +1,25 @@
+#ifndef SEQBOT_CACHE
+#define SEQBOT_CACHE
+
+#include <stdio.h>
+#include "seqbot_output.h"
+
+/* A cache of rendered instructions, keyed by the sequence they were
+ * rendered from. It holds at most a given number of bytes of sequences,
+ * output and bookkeeping, and evicts the least recently used entry to
+ * make room for a new one. One cache may be shared by several threads.
+ */
+struct render_cache;
+
+struct render_cache *create_render_cache(size_t capacity, enum output_format format);
+void free_render_cache(struct render_cache *cache);
+
+// render_instructions, appending the cached output if sequence has been seen
+int render_cached(struct render_cache *cache, struct out_buf *out,
+                  const char *sequence, int sequence_length,
+                  enum output_format format);
+
+// print the number of hits and misses to fp
+void report_render_cache(struct render_cache *cache, FILE *fp);
+
+#endif
@@ -0,0 +1,632 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "seqbot_helpers.h"
+#include "seqbot_output.h"
+#include "seqbot_render.h"
+#include "seqbot_bin.h"
+#include "seqbot_packed.h"
+
+// at most 4^GENALL_BLOCK_BASES lines are written by genall at a time
+#define GENALL_BLOCK_BASES 8
+// the smallest block used when the space is split between threads
+#define GENALL_MIN_BLOCK_BASES 4
+// aim for at least this many blocks per thread so the work stays balanced
+#define GENALL_BLOCKS_PER_THREAD 4
+// the largest k whose molecules can be numbered for --shard and --resume-from
+#define GENALL_MAX_RANGE_K 31
+
+/* The molecules a sharded or resumed genall prints: those whose index in
+ * lexicographic order is at least start and less than end.
+ */
+struct genall_range {
+    unsigned long start;
+    unsigned long end;
+};
+
+/* The shape of the genall output.
+ *   - the output is split into num_blocks blocks of lines lines each
+ *   - every line in a block shares its first prefix_len bases, and the
+ *     index of the block is those bases read as a base-4 number
+ *   - the last suffix_len bases of the lines are the same in every block
+ *   - the blocks from first_block up to but not including end_block are
+ *     written, starting at line first_line of the first and stopping
+ *     before line end_line of the last
+ *   - format is FORMAT_BIN if the instructions for each line are written
+ *     instead of the line itself
+ */
+struct genall_layout {
+    int k;
+    char header[16];
+    int header_len;
+    int prefix_len;
+    int suffix_len;
+    int line_len;
+    long lines;
+    long num_blocks;
+    long first_block;
+    long first_line;
+    long end_block;
+    long end_line;
+    enum output_format format;
+};
+
+/* A worker thread of a parallel genall and the block it fills.
+ *   - prefix is the prefix currently written into every line of block,
+ *     packed
+ *   - out holds the instructions for block when the format is FORMAT_BIN
+ *   - filled is the index of the block held in block, or -1 if none
+ */
+struct genall_worker {
+    pthread_t thread;
+    int id;
+    struct genall_job *job;
+    char *block;
+    struct packed_seq *prefix;
+    struct out_buf out;
+    long filled;
+};
+
+/* State shared between the workers and the ordered writer.
+ * Worker i fills blocks first_block + i, first_block + i + num_threads, ...
+ * A worker may only start its next block once its last one was written.
+ */
+struct genall_job {
+    struct genall_layout *layout;
+    int num_threads;
+    long written;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct genall_worker *workers;
+};
+
+/* Advance the n ASCII bases in bases to the next sequence in lexicographic
+ * order (A < C < G < T), like an odometer whose last base is the lowest digit.
+ * Return the index of the leftmost base that changed, or -1 if the bases
+ * wrapped around to all 'A'.
+ */
+static int advance_bases(char *bases, int n)
+{
+    static const char next_base[256] = {['A'] = 'C', ['C'] = 'G', ['G'] = 'T'};
+    int i;
+    for (i = n - 1; i >= 0 && bases[i] == 'T'; i--){
+        bases[i] = 'A';
+    }
+    if (i < 0){
+        return -1;
+    }
+    bases[i] = next_base[(unsigned char)bases[i]];
+    return i;
+}
+
+/* Fill in layout for molecules of length k split between num_threads.
+ * Return 0 on success or -1 if k is too large to number the blocks.
+ */
+static int init_layout(struct genall_layout *layout, int k, int num_threads)
+{
+    int m = k < GENALL_BLOCK_BASES ? k : GENALL_BLOCK_BASES;
+
+    // use smaller blocks if there would not be enough to share out; the
+    // shift is only taken while it fits in a long
+    while (num_threads > 1 && m > GENALL_MIN_BLOCK_BASES && 2 * (k - m) < 62
+           && (1L << (2 * (k - m))) < (long)num_threads * GENALL_BLOCKS_PER_THREAD){
+        m--;
+    }
+    if (2 * (k - m) > 62){
+        return -1;
+    }
+    layout->k = k;
+    layout->header_len = snprintf(layout->header, sizeof(layout->header), "%d ", k);
+    layout->prefix_len = k - m;
+    layout->suffix_len = m;
+    layout->line_len = layout->header_len + k + 3;
+    layout->lines = 1L << (2 * m);
+    layout->num_blocks = 1L << (2 * (k - m));
+    layout->first_block = 0;
+    layout->first_line = 0;
+    layout->end_block = layout->num_blocks;
+    layout->end_line = layout->lines;
+    return 0;
+}
+
+/* Limit the output of layout to the molecules of range, which is not
+ * empty.
+ */
+static void set_layout_range(struct genall_layout *layout,
+                             struct genall_range *range)
+{
+    layout->first_block = range->start / layout->lines;
+    layout->first_line = range->start % layout->lines;
+    layout->end_block = (range->end - 1) / layout->lines + 1;
+    layout->end_line = (range->end - 1) % layout->lines + 1;
+}
+
+/* Set *from and *to to the first line of block index that is written and
+ * the line after the last one.
+ */
+static void block_lines(struct genall_layout *layout, long index,
+                        long *from, long *to)
+{
+    *from = index == layout->first_block ? layout->first_line : 0;
+    *to = index == layout->end_block - 1 ? layout->end_line : layout->lines;
+}
+
+/* Create the block for the all 'A' prefix. The first line is all 'A', and
+ * each later line is the line before it with its suffix advanced by one.
+ */
+static char *create_block(struct genall_layout *layout)
+{
+    char *block = malloc(layout->lines * layout->line_len);
+    char *line;
+    int k = layout->k;
+
+    if (block == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    memcpy(block, layout->header, layout->header_len);
+    memset(block + layout->header_len, 'A', k);
+    memcpy(block + layout->header_len + k, " 0\n", 3);
+    for (long i = 1; i < layout->lines; i++){
+        line = block + i * layout->line_len;
+        memcpy(line, line - layout->line_len, layout->line_len);
+        advance_bases(line + layout->header_len + layout->prefix_len,
+                      layout->suffix_len);
+    }
+    return block;
+}
+
+/* Rewrite the lines of block, whose lines currently start with prefix, to
+ * start with the prefix of block index instead, and set prefix to it.
+ * The prefix has at most 31 bases, so it is one packed word, and the
+ * first base that differs is found with one XOR. Only the columns from
+ * that base onwards are touched.
+ */
+static void set_block_prefix(struct genall_layout *layout, char *block,
+                             struct packed_seq *prefix, long index)
+{
+    int n = layout->prefix_len;
+    uint64_t word = 0;
+    struct packed_seq next = {.length = n, .capacity = 1, .words = &word};
+    char bases[BASES_PER_WORD];
+    int changed;
+
+    for (int i = n - 1; i >= 0; i--){
+        set_base(&next, i, index & 3);
+        index >>= 2;
+    }
+    changed = first_difference(prefix, &next);
+    if (changed == n){
+        return;
+    }
+    prefix->words[0] = word;
+    decode_sequence(prefix, changed, n, bases);
+    for (long i = 0; i < layout->lines; i++){
+        memcpy(block + i * layout->line_len + layout->header_len + changed,
+               bases, n - changed);
+    }
+}
+
+/* Replace the contents of out with the binary instructions for every line
+ * of block index that is written.
+ */
+static void render_block(struct genall_layout *layout, char *block,
+                         long index, struct out_buf *out)
+{
+    long from;
+    long to;
+
+    block_lines(layout, index, &from, &to);
+    out->len = 0;
+    for (long i = from; i < to; i++){
+        render_instructions(out, block + i * layout->line_len + layout->header_len,
+                            layout->k, FORMAT_BIN);
+    }
+}
+
+/* Hand the lines of block index held in block, or its instructions held
+ * in out, to sink. Return the ticket of the lines, which are written in
+ * place, so block must not be rewritten until it has been waited for; the
+ * ticket of instructions is 0, since out is left empty for the next block.
+ */
+static unsigned long write_block(struct genall_layout *layout, char *block,
+                                 long index, struct out_buf *out,
+                                 struct out_sink *sink)
+{
+    long from;
+    long to;
+
+    if (layout->format == FORMAT_BIN){
+        submit_out_buf(sink, out);
+        return 0;
+    }
+    block_lines(layout, index, &from, &to);
+    return submit_out_data(sink, block + from * layout->line_len,
+                           (to - from) * layout->line_len);
+}
+
+/* Fill this worker's blocks in turn, waiting each time until the ordered
+ * writer has taken the previous one.
+ */
+static void *genall_worker_main(void *arg)
+{
+    struct genall_worker *worker = arg;
+    struct genall_job *job = worker->job;
+    struct genall_layout *layout = job->layout;
+
+    for (long b = layout->first_block + worker->id; b < layout->end_block;
+         b += job->num_threads){
+        pthread_mutex_lock(&job->lock);
+        while (job->written <= b - job->num_threads){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        set_block_prefix(layout, worker->block, worker->prefix, b);
+        if (layout->format == FORMAT_BIN){
+            render_block(layout, worker->block, b, &worker->out);
+        }
+
+        pthread_mutex_lock(&job->lock);
+        worker->filled = b;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+/* Fill the blocks on num_threads worker threads and hand them to sink in
+ * block order from this thread.
+ *
+ * A text block is only counted as written once sink has written it, which
+ * is waited for after the next block has been handed over, so that sink
+ * always has one block to go on with.
+ */
+static void genall_parallel(struct genall_layout *layout, int num_threads,
+                            struct out_sink *sink)
+{
+    struct genall_job job;
+    struct genall_worker *worker;
+    unsigned long ticket = 0;
+    unsigned long last;
+    int i;
+
+    job.layout = layout;
+    job.num_threads = num_threads;
+    job.written = layout->first_block;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    job.workers = malloc(num_threads * sizeof(struct genall_worker));
+    if (job.workers == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    for (i = 0; i < num_threads; i++){
+        worker = &job.workers[i];
+        worker->id = i;
+        worker->job = &job;
+        worker->block = create_block(layout);
+        worker->prefix = create_packed_seq(layout->prefix_len);
+        init_out_buf(&worker->out);
+        worker->filled = -1;
+        if (pthread_create(&worker->thread, NULL, genall_worker_main, worker) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    for (long b = layout->first_block; b < layout->end_block; b++){
+        worker = &job.workers[(b - layout->first_block) % num_threads];
+        pthread_mutex_lock(&job.lock);
+        while (worker->filled != b){
+            pthread_cond_wait(&job.cond, &job.lock);
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        last = ticket;
+        ticket = write_block(layout, worker->block, b, &worker->out, sink);
+        if (ticket == 0){
+            pthread_mutex_lock(&job.lock);
+            job.written = b + 1;
+            pthread_cond_broadcast(&job.cond);
+            pthread_mutex_unlock(&job.lock);
+            continue;
+        }
+        wait_out_sink(sink, last);
+        pthread_mutex_lock(&job.lock);
+        job.written = b;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+    wait_out_sink(sink, ticket);
+
+    for (i = 0; i < num_threads; i++){
+        pthread_join(job.workers[i].thread, NULL);
+        free(job.workers[i].block);
+        free_packed_seq(job.workers[i].prefix);
+        free_out_buf(&job.workers[i].out);
+    }
+    free(job.workers);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+}
+
+/* Return x / 2 rounded down, for negative x as well.
+ */
+static long floor_half(long x)
+{
+    return x >= 0 ? x / 2 : -((1 - x) / 2);
+}
+
+/* Print the sequences of length k whose G/C count is between gc_min and
+ * gc_max, in lexicographic order, as lines or in the binary format.
+ *
+ * This is a depth-first search with an explicit stack. next[d] is the next
+ * base to try at depth d, and gc[d] the G/C count of the first d bases. A
+ * base is skipped as soon as the G/C count it gives is above gc_max, or
+ * is so low that even all G/C for the rest could not reach gc_min. Every
+ * prefix that is kept therefore has at least one match below it, so the
+ * work is at most k steps per line written rather than 4^k.
+ *
+ * If range is not NULL only the sequences in it are printed. index[d] is
+ * the number the first d bases make in base 4, and a base is skipped if
+ * none of the sequences that start with it are in the range. The search
+ * stops at the first one past its end.
+ */
+static void genall_window(int k, int gc_min, int gc_max,
+                          enum output_format format, struct genall_range *range,
+                          struct out_sink *sink)
+{
+    char header[16];
+    int header_len = snprintf(header, sizeof(header), "%d ", k);
+    size_t line_len = (size_t)header_len + k + 3;
+    // k comes from the command line, so none of these go on the stack
+    char *line = malloc(line_len);
+    int *next = malloc(k * sizeof(int));
+    int *gc = malloc((k + 1) * sizeof(int));
+    unsigned long *index = malloc((k + 1) * sizeof(unsigned long));
+    char *bases = line + header_len;
+    unsigned long span;
+    unsigned long first;
+    struct out_buf out;
+    int d = 0;
+    int b;
+    int g;
+
+    if (line == NULL || next == NULL || gc == NULL || index == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    memcpy(line, header, header_len);
+    memcpy(bases + k, " 0\n", 3);
+    init_out_buf(&out);
+    gc[0] = 0;
+    index[0] = 0;
+    next[0] = BASE_A;
+    while (d >= 0){
+        if (next[d] > BASE_T){
+            d--;
+            continue;
+        }
+        b = next[d]++;
+        g = gc[d] + (b == BASE_C || b == BASE_G);
+        if (g > gc_max || g + (k - d - 1) < gc_min){
+            continue;
+        }
+        if (range != NULL){
+            // the sequences that start with b are first to first + span - 1
+            span = 1UL << (2 * (k - d - 1));
+            first = (index[d] * 4 + b) * span;
+            if (first >= range->end){
+                break;
+            }
+            if (first + span <= range->start){
+                continue;
+            }
+            index[d + 1] = index[d] * 4 + b;
+        }
+        bases[d] = base_char[b];
+        if (d < k - 1){
+            gc[d + 1] = g;
+            next[++d] = BASE_A;
+            continue;
+        }
+        if (format == FORMAT_BIN){
+            render_instructions(&out, bases, k, FORMAT_BIN);
+        }
+        else {
+            append_out_buf(&out, line, line_len);
+        }
+        if (out.len >= OUT_SINK_SIZE){
+            submit_out_buf(sink, &out);
+        }
+    }
+    submit_out_buf(sink, &out);
+    free_out_buf(&out);
+    free(line);
+    free(next);
+    free(gc);
+    free(index);
+}
+
+/* Set range to the molecules of length k that opts asks for, and return 0,
+ * or return -1 if it asks for all of them.
+ * The shard is the molecules from total * (shard - 1) / num_shards up to
+ * total * shard / num_shards, where total is 4^k, and resuming starts it
+ * after the molecule opts->resume_from. The program exits with an error if
+ * k is too large to number the molecules, or resume_from is not a molecule
+ * of the shard.
+ */
+static int find_range(int k, struct genall_options *opts,
+                      struct genall_range *range)
+{
+    unsigned long total;
+    unsigned long index = 0;
+    const char *base;
+
+    if (opts->num_shards <= 1 && opts->resume_from == NULL){
+        return -1;
+    }
+    if (k > GENALL_MAX_RANGE_K){
+        fprintf(stderr, "genall: --shard and --resume-from need a size of at most %d\n",
+                GENALL_MAX_RANGE_K);
+        exit(1);
+    }
+    total = 1UL << (2 * k);
+    range->start = (unsigned __int128)total * (opts->shard - 1) / opts->num_shards;
+    range->end = (unsigned __int128)total * opts->shard / opts->num_shards;
+    if (opts->resume_from == NULL){
+        return 0;
+    }
+    if (strlen(opts->resume_from) != (size_t)k){
+        fprintf(stderr, "genall: --resume-from must be a sequence of length %d\n", k);
+        exit(1);
+    }
+    for (int i = 0; i < k; i++){
+        base = strchr("ACGT", opts->resume_from[i]);
+        if (base == NULL){
+            fprintf(stderr, "genall: --resume-from must be a sequence of length %d\n", k);
+            exit(1);
+        }
+        index = index * 4 + (base - "ACGT");
+    }
+    if (index < range->start || index >= range->end){
+        fprintf(stderr, "genall: %s is not in this shard\n", opts->resume_from);
+        exit(1);
+    }
+    range->start = index + 1;
+    return 0;
+}
+
+/* Print to standard output all of the sequences of length k.
+ * The format of the output is "<length> <sequence> 0" to
+ * correspond to the input format required by generate_molecules_from_file()
+ */
+void generate_all_molecules(int k)
+{
+    struct genall_options opts = {.num_threads = 1, .format = FORMAT_TEXT,
+                                  .tm_window = 0, .shard = 1, .num_shards = 1,
+                                  .resume_from = NULL};
+    generate_all_molecules_with_options(k, &opts);
+}
+
+/* Print all of the sequences of length k as generate_all_molecules does,
+ * using the settings in opts.
+ *
+ * The output is built in blocks of the 4^m lines that share their first
+ * k - m bases, where m is at most GENALL_BLOCK_BASES. The last m bases of
+ * every line are the same in every block, so they are written once; for
+ * each following block only the part of the shared prefix that changed is
+ * rewritten in each line before the block is handed to an output sink,
+ * which writes it in place. Two blocks are filled in turn, so one can be
+ * filled while the other is written.
+ *
+ * With opts->num_threads > 1 the blocks are filled by that many threads and
+ * written in order, so the output is the same as with one thread.
+ *
+ * With opts->format == FORMAT_BIN the lines are not written; instead each
+ * block is rendered into the binary instructions for its molecules, after
+ * BIN_MAGIC at the start of the output.
+ *
+ * With opts->tm_window set only the sequences whose melting temperature is
+ * between opts->tm_min and opts->tm_max are printed, found by genall_window
+ * on one thread. The temperature is 2k plus twice the G/C count, so the
+ * window is a range of G/C counts.
+ *
+ * With opts->num_shards > 1 or opts->resume_from set only the molecules of
+ * the range find_range gives are printed, so shards printed on several
+ * machines add up to the whole output, in order. The blocks outside the
+ * range are never filled, and the ones at its ends are written in part.
+ * Output that resumes an earlier run continues it, so it has no
+ * BIN_MAGIC.
+ */
+void generate_all_molecules_with_options(int k, struct genall_options *opts)
+{
+    struct genall_layout layout;
+    struct genall_range range;
+    int num_threads = opts->num_threads;
+    int ranged;
+    int magic;
+    char *block[2];
+    struct packed_seq *prefix[2];
+    unsigned long ticket[2] = {0, 0};
+    int turn;
+    struct out_buf out;
+    struct out_sink *sink;
+    long gc_min = 0;
+    long gc_max = k;
+
+    if (k <= 0){
+        return;
+    }
+    ranged = find_range(k, opts, &range) == 0;
+    magic = opts->format == FORMAT_BIN && opts->resume_from == NULL;
+    if (opts->tm_window){
+        // smallest and largest G/C counts with 2k + 2gc inside the window
+        gc_min = -floor_half(2L * k - opts->tm_min);
+        gc_max = floor_half(opts->tm_max - 2L * k);
+        gc_min = gc_min < 0 ? 0 : gc_min;
+        gc_max = gc_max > k ? k : gc_max;
+    }
+    if (gc_min > 0 || gc_max < k){
+        fflush(stdout);
+        if (magic){
+            write_all(STDOUT_FILENO, BIN_MAGIC, BIN_MAGIC_LEN);
+        }
+        if (gc_min <= gc_max && (!ranged || range.start < range.end)){
+            sink = open_out_sink(STDOUT_FILENO);
+            genall_window(k, gc_min, gc_max, opts->format,
+                          ranged ? &range : NULL, sink);
+            close_out_sink(sink);
+        }
+        return;
+    }
+    if (init_layout(&layout, k, num_threads) != 0){
+        fprintf(stderr, "genall: size %d is too large\n", k);
+        exit(1);
+    }
+    layout.format = opts->format;
+    fflush(stdout);
+    if (magic){
+        write_all(STDOUT_FILENO, BIN_MAGIC, BIN_MAGIC_LEN);
+    }
+    if (ranged){
+        if (range.start == range.end){
+            return;
+        }
+        set_layout_range(&layout, &range);
+    }
+    if (num_threads > layout.end_block - layout.first_block){
+        num_threads = layout.end_block - layout.first_block;
+    }
+    sink = open_out_sink(STDOUT_FILENO);
+    if (num_threads > 1){
+        genall_parallel(&layout, num_threads, sink);
+        close_out_sink(sink);
+        return;
+    }
+
+    for (turn = 0; turn < 2; turn++){
+        block[turn] = create_block(&layout);
+        prefix[turn] = create_packed_seq(layout.prefix_len);
+    }
+    init_out_buf(&out);
+    for (long b = layout.first_block; b < layout.end_block; b++){
+        turn = (b - layout.first_block) & 1;
+        wait_out_sink(sink, ticket[turn]);
+        set_block_prefix(&layout, block[turn], prefix[turn], b);
+        if (layout.format == FORMAT_BIN){
+            render_block(&layout, block[turn], b, &out);
+        }
+        ticket[turn] = write_block(&layout, block[turn], b, &out, sink);
+    }
+    close_out_sink(sink);
+    for (turn = 0; turn < 2; turn++){
+        free(block[turn]);
+        free_packed_seq(prefix[turn]);
+    }
+    free_out_buf(&out);
+}
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "seqbot_helpers.h"
+#include "seqbot_reader.h"
+#include "seqbot_revcomp.h"
+#include "seqbot_render.h"
+#include "seqbot_output.h"
+#include "seqbot_bin.h"
+#include "seqbot_cache.h"
+
+// a batch ends after this many records or once it holds this many bases
+#define GENFILE_BATCH_RECORDS 256
+#define GENFILE_BATCH_BASES (1 << 16)
+// the most batches that may be read but not yet written at once
+#define GENFILE_QUEUE_BATCHES 64
+
+/* Transform the bases of record by its mode in place, then append the
+ * instructions for them to out. The transform keeps invalid characters
+ * invalid, so render_instructions validates the sequence in the same pass
+ * that renders it.
+ * The instructions are written in format, through cache if it is not NULL.
+ * Return the melting temperature, or -1 without changing out if the record
+ * breaks any of the rules checked by generate_molecules_from_file.
+ */
+static int render_record(struct out_buf *out, struct genfile_record *record,
+                         enum output_format format, struct render_cache *cache)
+{
+    if (record->length != record->sequence_len || record->length <= 0
+        || record->length > INT_MAX || record->mode < 0 || record->mode > 3){
+        return -1;
+    }
+    transform_sequence(record->sequence, record->length, record->mode);
+    return render_cached(cache, out, record->sequence, record->length, format);
+}
+
+/* A run of consecutive records and the output rendered for them.
+ *   - index is the position of the batch in the input, counting from 0
+ *   - truncated is 1 if the line after the last record is not a record
+ *   - invalid is 1 once rendering stopped at an invalid record; out then
+ *     holds the output of the records before it
+ *   - end is where the scanner stopped after the last record, so the
+ *     input before it is finished with once the batch is written
+ *   - state is the stage of the pipeline the batch has reached
+ */
+struct genfile_batch {
+    long index;
+    int num_records;
+    char *end;
+    struct genfile_record records[GENFILE_BATCH_RECORDS];
+    int truncated;
+    int invalid;
+    struct out_buf out;
+    enum {BATCH_FREE, BATCH_READ, BATCH_RENDERED} state;
+};
+
+/* State shared by the reader, the workers and the ordered writer.
+ * The batches form a ring of GENFILE_QUEUE_BATCHES slots, and batch i lives
+ * in slot i % GENFILE_QUEUE_BATCHES. The reader only fills a slot once the
+ * writer has written the batch that used it before, which bounds the
+ * memory held by batches in flight.
+ *   - read is the number of batches the reader has filled
+ *   - claimed is the number of batches workers have started rendering
+ *   - written is the number of batches the writer has written
+ *   - format is the format the workers render in
+ *   - cache is the cache the workers share, or NULL
+ *   - done is 1 once the reader has reached the end of the input
+ *   - cancelled is 1 once the writer has found an invalid record; every
+ *     thread then stops at its next check
+ */
+struct genfile_job {
+    struct genfile_input *input;
+    struct genfile_scanner scanner;
+    struct genfile_batch batches[GENFILE_QUEUE_BATCHES];
+    long read;
+    long claimed;
+    long written;
+    enum output_format format;
+    struct render_cache *cache;
+    int done;
+    int cancelled;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/* Parse records into the next free batch slot until the input ends, a line
+ * is not a record, or the job is cancelled.
+ */
+static void *genfile_reader_main(void *arg)
+{
+    struct genfile_job *job = arg;
+    struct genfile_batch *batch;
+    long bases;
+    int status = 1;
+
+    while (status > 0){
+        pthread_mutex_lock(&job->lock);
+        while (!job->cancelled && job->read - job->written >= GENFILE_QUEUE_BATCHES){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        if (job->cancelled){
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        batch = &job->batches[job->read % GENFILE_QUEUE_BATCHES];
+        batch->index = job->read;
+        batch->num_records = 0;
+        batch->truncated = 0;
+        batch->invalid = 0;
+        batch->out.len = 0;
+        bases = 0;
+        while (batch->num_records < GENFILE_BATCH_RECORDS && bases < GENFILE_BATCH_BASES){
+            status = next_record(&job->scanner, &batch->records[batch->num_records]);
+            if (status <= 0){
+                batch->truncated = status < 0;
+                break;
+            }
+            bases += batch->records[batch->num_records].sequence_len;
+            batch->num_records++;
+        }
+        batch->end = job->scanner.pos;
+        if (batch->num_records == 0 && !batch->truncated){
+            break;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = BATCH_READ;
+        job->read++;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->done = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Render the next unclaimed batch until there are none left or the job is
+ * cancelled. A batch stops at its first invalid record.
+ */
+static void *genfile_worker_main(void *arg)
+{
+    struct genfile_job *job = arg;
+    struct genfile_batch *batch;
+
+    while (1){
+        pthread_mutex_lock(&job->lock);
+        while (!job->cancelled && job->claimed == job->read && !job->done){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        if (job->cancelled || job->claimed == job->read){
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        batch = &job->batches[job->claimed % GENFILE_QUEUE_BATCHES];
+        job->claimed++;
+        pthread_mutex_unlock(&job->lock);
+
+        for (int i = 0; i < batch->num_records; i++){
+            if (render_record(&batch->out, &batch->records[i], job->format, job->cache) < 0){
+                batch->invalid = 1;
+                break;
+            }
+        }
+        if (batch->truncated){
+            batch->invalid = 1;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = BATCH_RENDERED;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/* Run the records of scanner through a reader thread and opts->num_threads
+ * worker threads, and hand the rendered batches to sink in input order
+ * from this thread. Return 0 if every record was valid, or -1 after writing
+ * the output of the records before the first invalid one.
+ */
+static int genfile_parallel(struct genfile_input *input,
+                            struct genfile_scanner *scanner,
+                            struct genfile_options *opts,
+                            struct render_cache *cache,
+                            struct out_sink *sink)
+{
+    int num_threads = opts->num_threads;
+    struct genfile_job *job = malloc(sizeof(struct genfile_job));
+    struct genfile_batch *batch;
+    pthread_t reader;
+    pthread_t workers[num_threads];
+    int ret = 0;
+    int i;
+
+    if (job == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    job->input = input;
+    job->scanner = *scanner;
+    job->read = 0;
+    job->claimed = 0;
+    job->written = 0;
+    job->format = opts->format;
+    job->cache = cache;
+    job->done = 0;
+    job->cancelled = 0;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    for (i = 0; i < GENFILE_QUEUE_BATCHES; i++){
+        job->batches[i].state = BATCH_FREE;
+        init_out_buf(&job->batches[i].out);
+    }
+    if (pthread_create(&reader, NULL, genfile_reader_main, job) != 0){
+        perror("pthread_create");
+        exit(1);
+    }
+    for (i = 0; i < num_threads; i++){
+        if (pthread_create(&workers[i], NULL, genfile_worker_main, job) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    while (1){
+        batch = &job->batches[job->written % GENFILE_QUEUE_BATCHES];
+        pthread_mutex_lock(&job->lock);
+        while (!(job->written < job->read && batch->state == BATCH_RENDERED)
+               && !(job->done && job->written == job->read)){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        if (job->written == job->read){
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        submit_out_buf(sink, &batch->out);
+        release_genfile_input(input, batch->end);
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = BATCH_FREE;
+        job->written++;
+        if (batch->invalid){
+            job->cancelled = 1;
+            ret = -1;
+        }
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+        if (ret < 0){
+            break;
+        }
+    }
+
+    pthread_join(reader, NULL);
+    for (i = 0; i < num_threads; i++){
+        pthread_join(workers[i], NULL);
+    }
+    for (i = 0; i < GENFILE_QUEUE_BATCHES; i++){
+        free_out_buf(&job->batches[i].out);
+    }
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+    return ret;
+}
+
+/* Render the records of scanner on this thread, handing the output to
+ * sink each time OUT_SINK_SIZE bytes have built up and then giving back the
+ * input before the scanner. Return 0 if every record
+ * was valid, or -1 after writing the output of the records before the
+ * first invalid one.
+ */
+static int genfile_serial(struct genfile_input *input,
+                          struct genfile_scanner *scanner,
+                          struct genfile_options *opts,
+                          struct render_cache *cache,
+                          struct out_sink *sink)
+{
+    struct genfile_record record;
+    struct out_buf out;
+    int status;
+    int ret = 0;
+
+    init_out_buf(&out);
+    while ((status = next_record(scanner, &record)) != 0){
+        if (status < 0 || render_record(&out, &record, opts->format, cache) < 0){
+            ret = -1;
+            break;
+        }
+        if (out.len >= OUT_SINK_SIZE){
+            submit_out_buf(sink, &out);
+            release_genfile_input(input, scanner->pos);
+        }
+    }
+    submit_out_buf(sink, &out);
+    free_out_buf(&out);
+    return ret;
+}
+
+/* Print the instructions for each of the sequences found in filename according
+ * to the mode provided.
+ * filename contains one sequence per line, and the format of each line is
+ * "<length> <sequence> <mode>" where
+ *     - <length> is the number of characters in the sequence
+ *     - <sequence> is the array of DNA characters
+ *     - <mode> is either 0, 1, 2, or 3 indicating how the <sequence> should
+ *              be modified before printing the instrutions. The modes have the
+ *              following meanings:
+ *         - 0  - print instructions for sequence (unmodified)
+ *         - 1  - print instructions for the the complement of sequence
+ *         - 2  - print instructions for the reverse of sequence
+ *         - 3  - print instructions for sequence where it is complemented
+ *                and reversed.
+ *
+ * Error checking: If any of the following error conditions occur, the function
+ * immediately prints "INVALID SEQUENCE" to standard output and exits the
+ * program with a exit code of 1.
+ *  - length does not match the number of characters in sequence
+ *  - length is not a positive number
+ *  - sequence contains at least one invalid character
+ *  - mode is not a number between 0 and 3 inclusive
+ *  - the line is not made of those three fields
+ *  - a FASTA or FASTQ record is not complete
+ *
+ * The file is mapped into memory and scanned in place, so there is no limit
+ * on the length of a sequence and no copy of it is made. Each sequence is
+ * transformed by its mode in place with transform_sequence, then validated
+ * and rendered in one pass with render_instructions.
+ *
+ * filename may instead be a FASTA or FASTQ file, recognised by a first
+ * character of '>' or '@'. Its sequences may be wrapped over several lines,
+ * are given the length they are found to have, and are printed unmodified.
+ *
+ * Any of these may be gzip compressed. A compressed file is inflated by a
+ * thread of its own while its records are printed.
+ */
+void generate_molecules_from_file(char* filename)
+{
+    struct genfile_options opts = {.num_threads = 1, .format = FORMAT_TEXT,
+                                   .default_mode = 0, .cache_size = 0};
+    generate_molecules_from_file_with_options(filename, &opts);
+}
+
+/* Print the instructions for the sequences in filename as
+ * generate_molecules_from_file does, using the settings in opts.
+ *
+ * With opts->num_threads > 1 a reader thread splits the records into
+ * batches, the worker threads validate and render whole batches, and this
+ * thread writes them in input order. At most GENFILE_QUEUE_BATCHES batches
+ * are in flight at once. The first invalid record cancels the threads once
+ * everything before it has been written, so the output is the same as with
+ * one thread.
+ *
+ * With opts->format == FORMAT_BIN the instructions are written as the
+ * binary stream of seqbot_bin.h, and INVALID SEQUENCE as BIN_INVALID.
+ *
+ * The records of a FASTA or FASTQ file are given opts->default_mode.
+ *
+ * With opts->cache_size > 0 the output of each sequence, after its
+ * transform, is kept in a least recently used cache of that many bytes,
+ * and a sequence found in the cache is copied instead of rendered again.
+ * The number of hits and misses is printed to stderr at the end.
+ */
+void generate_molecules_from_file_with_options(char *filename,
+                                               struct genfile_options *opts)
+{
+    struct genfile_input input;
+    struct genfile_scanner scanner;
+    struct render_cache *cache = NULL;
+    struct out_sink *sink;
+    int ret;
+
+    open_genfile_input(filename, &input);
+    init_scanner(&scanner, &input, opts->default_mode);
+    if (opts->cache_size > 0){
+        cache = create_render_cache(opts->cache_size, opts->format);
+    }
+
+    fflush(stdout);
+    if (opts->format == FORMAT_BIN){
+        write_all(STDOUT_FILENO, BIN_MAGIC, BIN_MAGIC_LEN);
+    }
+    sink = open_out_sink(STDOUT_FILENO);
+    if (opts->num_threads > 1){
+        ret = genfile_parallel(&input, &scanner, opts, cache, sink);
+    }
+    else {
+        ret = genfile_serial(&input, &scanner, opts, cache, sink);
+    }
+    // everything before an invalid record is written before INVALID SEQUENCE
+    close_out_sink(sink);
+    close_genfile_input(&input);
+    if (cache != NULL){
+        report_render_cache(cache, stderr);
+        free_render_cache(cache);
+    }
+    if (ret < 0){
+        if (opts->format == FORMAT_BIN){
+            char invalid = BIN_INVALID;
+            write_all(STDOUT_FILENO, &invalid, 1);
+            exit(1);
+        }
+        printf("INVALID SEQUENCE");
+        exit(1);
+    }
+}
@@ -1,16 +1,99 @@
 #ifndef SEQBOT_HELPERS
 #define SEQBOT_HELPERS
 
+#include "seqbot_output.h"
+
 // calculate the melting tempearture for the dna sequence
 int calculate_melting_temperature(char *sequence, int sequence_length);
 
 // print the instructions to synthesize the given DNA sequence to stdout
 void print_instructions(char *sequence, int sequence_length);
+void print_instructions_with_format(char *sequence, int sequence_length,
+                                    enum output_format format);
+
+/* Settings for generate_all_molecules_with_options
+ *   - num_threads is the number of threads that build the output
+ *   - format is FORMAT_TEXT for the "<length> <sequence> 0" lines, or
+ *     FORMAT_BIN for the binary instructions of every molecule
+ *   - tm_window is 1 if only the molecules with a melting temperature from
+ *     tm_min to tm_max (inclusive) are wanted; these are found on one thread
+ *   - shard picks one of num_shards equal ranges of the molecules, in the
+ *     order they are printed, counting from 1; num_shards is 1 for all
+ *   - resume_from is the last molecule printed by an interrupted run, so
+ *     that only the ones after it are printed, or NULL to start at the
+ *     beginning
+ */
+struct genall_options {
+    int num_threads;
+    enum output_format format;
+    int tm_window;
+    int tm_min;
+    int tm_max;
+    int shard;
+    int num_shards;
+    char *resume_from;
+};
 
 // print the sequences for all possible molecules of length k
 void generate_all_molecules(int k);
+void generate_all_molecules_with_options(int k, struct genall_options *opts);
+
+// print how many molecules of length k there are by temperature and runs
+void print_genall_stats(int k);
+
+/* Settings for generate_molecules_from_file_with_options
+ *   - num_threads is the number of threads that render the output
+ *   - format is the format the instructions are written in
+ *   - default_mode is the mode used for the records of a FASTA or FASTQ
+ *     file, which have no mode of their own
+ *   - cache_size is the number of bytes the cache of rendered sequences
+ *     may hold, or 0 to render every sequence
+ */
+struct genfile_options {
+    int num_threads;
+    enum output_format format;
+    int default_mode;
+    size_t cache_size;
+};
 
 // generate the instructions for the molecules described in filename
 void generate_molecules_from_file(char* filename);
+void generate_molecules_from_file_with_options(char *filename,
+                                               struct genfile_options *opts);
+
+/* Settings for count_kmers
+ *   - num_threads is the number of threads that count
+ *   - top is the number of most frequent k-mers to print, or 0 for all
+ */
+struct kmer_options {
+    int num_threads;
+    long top;
+};
+
+// print the counts of the canonical k-mers of the sequences in filename
+void count_kmers(int k, char *filename, struct kmer_options *opts);
+
+/* Settings for print_melting_profile
+ *   - tm_min and tm_max are the lowest and highest temperatures of the
+ *     windows that are printed
+ */
+struct profile_options {
+    int tm_min;
+    int tm_max;
+};
+
+// print the melting temperature of every window of the sequences in filename
+void print_melting_profile(int window, char *filename,
+                           struct profile_options *opts);
+
+/* Settings for serve_requests
+ *   - num_threads is the number of threads that answer requests
+ */
+struct serve_options {
+    int num_threads;
+};
+
+// answer melt, print and genfile requests sent to a Unix domain socket
+void serve_requests(char *socket_path, struct serve_options *opts);
 
 #endif
@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "seqbot_helpers.h"
+#include "seqbot_reader.h"
+#include "seqbot_output.h"
+
+// a batch holds this many records, or records holding this many bases
+#define KMER_BATCH_RECORDS 256
+#define KMER_BATCH_BASES (1 << 16)
+// the most batches that are parsed and not yet counted
+#define KMER_QUEUE_BATCHES 64
+// the number of slots a table starts with; it doubles when 3/4 full
+#define KMER_TABLE_SIZE (1 << 16)
+// a worker hands the k-mers of a shard over this many at a time
+#define KMER_BUCKET_SIZE 1024
+// marks an empty slot. No canonical k-mer is all ones: its reverse
+// complement would be all zeros, which is smaller.
+#define KMER_EMPTY UINT64_MAX
+
+// maps an ASCII character to its 2-bit code, or -1 if it is not a base.
+// Lower case bases are counted too, since FASTA files use them for masking.
+static const signed char kmer_code[256] = {
+    [0 ... 255] = -1,
+    ['A'] = 0, ['C'] = 1, ['G'] = 2, ['T'] = 3,
+    ['a'] = 0, ['c'] = 1, ['g'] = 2, ['t'] = 3
+};
+
+/* A k-mer and its count: a slot of a table, and an entry of the sorted
+ * output. A slot is empty when kmer is KMER_EMPTY.
+ */
+struct kmer_count {
+    uint64_t kmer;
+    uint64_t count;
+};
+
+/* An open addressing hash table from k-mers to counts, with linear probing.
+ * A k-mer and its count share a slot, so a lookup touches one cache line.
+ *   - capacity is the number of slots, a power of 2
+ *   - size is the number of slots in use
+ */
+struct kmer_table {
+    struct kmer_count *slots;
+    size_t capacity;
+    size_t size;
+};
+
+/* The k-mers whose hash picks one shard, counted in a table of its own.
+ * A worker adds to it under lock, a bucket of k-mers at a time.
+ *   - counts and size are its counts once they are packed and sorted
+ */
+struct kmer_shard {
+    struct kmer_table table;
+    pthread_mutex_t lock;
+    struct kmer_count *counts;
+    size_t size;
+};
+
+/* Records parsed by the reader for a worker to count.
+ *   - end is where the scanner stopped after the last record, so the
+ *     input before it is finished with once the batch is counted
+ *   - state is how far the batch has got
+ */
+struct kmer_batch {
+    int num_records;
+    char *end;
+    struct genfile_record records[KMER_BATCH_RECORDS];
+    enum {BATCH_FREE, BATCH_READ, BATCH_COUNTED} state;
+};
+
+/* State shared by the reader and the counting threads. Every k-mer is
+ * counted in the one shard its hash picks, so each k-mer is held once
+ * however many threads see it, and there is nothing to merge at the end.
+ *
+ * The batches form a ring of KMER_QUEUE_BATCHES slots, as in genfile, and
+ * batch i lives in slot i % KMER_QUEUE_BATCHES. Only the reader touches
+ * the scanner, so parsing is never done under the lock.
+ *   - read is the number of batches the reader has filled
+ *   - claimed is the number of batches workers have started counting
+ *   - retired is the number of batches counted and given back in order;
+ *     the input before the end of the last one is given back with them
+ *   - done is 1 once the reader has reached the end of the input
+ *   - invalid is 1 once a record could not be parsed
+ */
+struct kmer_job {
+    int k;
+    int num_threads;
+    struct genfile_input *input;
+    struct genfile_scanner scanner;
+    struct kmer_batch batches[KMER_QUEUE_BATCHES];
+    long read;
+    long claimed;
+    long retired;
+    int done;
+    struct kmer_shard *shards;
+    int num_shards;
+    long top;
+    int invalid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/* A counting thread and the k-mers it has seen but not yet added to
+ * their shards: bucket_len[s] of them from buckets + s * KMER_BUCKET_SIZE
+ * for shard s.
+ */
+struct kmer_worker {
+    struct kmer_job *job;
+    int index;
+    uint64_t *buckets;
+    int *bucket_len;
+};
+
+static void init_kmer_table(struct kmer_table *table, size_t capacity)
+{
+    table->slots = malloc(capacity * sizeof(struct kmer_count));
+    if (table->slots == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < capacity; i++){
+        table->slots[i].kmer = KMER_EMPTY;
+    }
+    table->capacity = capacity;
+    table->size = 0;
+}
+
+static void free_kmer_table(struct kmer_table *table)
+{
+    free(table->slots);
+}
+
+/* The splitmix64 finalizer, so that the low bits used to pick a slot and
+ * the high bits used to pick a shard depend on every base of the k-mer.
+ */
+static size_t hash_kmer(uint64_t kmer)
+{
+    kmer ^= kmer >> 30;
+    kmer *= 0xbf58476d1ce4e5b9ULL;
+    kmer ^= kmer >> 27;
+    kmer *= 0x94d049bb133111ebULL;
+    kmer ^= kmer >> 31;
+    return kmer;
+}
+
+/* Add count to the count of kmer, doubling the table once it is 3/4 full.
+ */
+static void add_kmer(struct kmer_table *table, uint64_t kmer, uint64_t count)
+{
+    size_t mask = table->capacity - 1;
+    struct kmer_count *slot = &table->slots[hash_kmer(kmer) & mask];
+
+    while (slot->kmer != kmer && slot->kmer != KMER_EMPTY){
+        slot = &table->slots[(slot - table->slots + 1) & mask];
+    }
+    if (slot->kmer == kmer){
+        slot->count += count;
+        return;
+    }
+    slot->kmer = kmer;
+    slot->count = count;
+    table->size++;
+    if (table->size * 4 > table->capacity * 3){
+        struct kmer_table bigger;
+        init_kmer_table(&bigger, table->capacity * 2);
+        for (size_t j = 0; j < table->capacity; j++){
+            if (table->slots[j].kmer != KMER_EMPTY){
+                add_kmer(&bigger, table->slots[j].kmer, table->slots[j].count);
+            }
+        }
+        free_kmer_table(table);
+        *table = bigger;
+    }
+}
+
+/* Add the k-mers in the bucket of shard s of worker to the shard's table
+ * and empty the bucket.
+ */
+static void flush_bucket(struct kmer_worker *worker, int s)
+{
+    struct kmer_shard *shard = &worker->job->shards[s];
+    uint64_t *bucket = worker->buckets + (size_t)s * KMER_BUCKET_SIZE;
+
+    pthread_mutex_lock(&shard->lock);
+    for (int i = 0; i < worker->bucket_len[s]; i++){
+        add_kmer(&shard->table, bucket[i], 1);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    worker->bucket_len[s] = 0;
+}
+
+/* Put kmer in the bucket of the shard that the high bits of its hash
+ * pick, handing the bucket over to the shard once it is full.
+ */
+static void route_kmer(struct kmer_worker *worker, uint64_t kmer)
+{
+    int s = ((hash_kmer(kmer) >> 32) * worker->job->num_shards) >> 32;
+
+    worker->buckets[(size_t)s * KMER_BUCKET_SIZE + worker->bucket_len[s]++] = kmer;
+    if (worker->bucket_len[s] == KMER_BUCKET_SIZE){
+        flush_bucket(worker, s);
+    }
+}
+
+/* Count the canonical k-mers of sequence for worker. The k-mer and its
+ * reverse complement are rolled along together, 2 bits per base, and the
+ * smaller of the two is counted. A character that is not a base starts a
+ * new window after it.
+ */
+static void count_sequence(struct kmer_worker *worker, int k,
+                           const char *sequence, long length)
+{
+    uint64_t mask = k == 32 ? UINT64_MAX : ((uint64_t)1 << (2 * k)) - 1;
+    int shift = 2 * (k - 1);
+    uint64_t forward = 0;
+    uint64_t reverse = 0;
+    int valid = 0;
+    int code;
+
+    for (long i = 0; i < length; i++){
+        code = kmer_code[(unsigned char)sequence[i]];
+        if (code < 0){
+            valid = 0;
+            continue;
+        }
+        forward = ((forward << 2) | code) & mask;
+        reverse = (reverse >> 2) | ((uint64_t)(3 - code) << shift);
+        if (++valid >= k){
+            route_kmer(worker, forward < reverse ? forward : reverse);
+        }
+    }
+}
+
+/* Parse records into the next free batch slot until the input ends or a
+ * line is not a record.
+ */
+static void *kmer_reader_main(void *arg)
+{
+    struct kmer_job *job = arg;
+    struct kmer_batch *batch;
+    long bases;
+    int status = 1;
+
+    while (status > 0){
+        pthread_mutex_lock(&job->lock);
+        while (job->read - job->retired >= KMER_QUEUE_BATCHES){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        batch = &job->batches[job->read % KMER_QUEUE_BATCHES];
+        batch->num_records = 0;
+        bases = 0;
+        while (batch->num_records < KMER_BATCH_RECORDS && bases < KMER_BATCH_BASES){
+            status = next_record(&job->scanner, &batch->records[batch->num_records]);
+            if (status <= 0){
+                break;
+            }
+            bases += batch->records[batch->num_records].sequence_len;
+            batch->num_records++;
+        }
+        batch->end = job->scanner.pos;
+        if (status < 0 || batch->num_records == 0){
+            break;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = BATCH_READ;
+        job->read++;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->invalid = status < 0;
+    job->done = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Count the next unclaimed batch into the shards until there are none
+ * left or a record was malformed, then hand over what is left in the
+ * buckets. A counted batch is given back, with the input before it, once
+ * every batch before it is counted too.
+ */
+static void *kmer_worker_main(void *arg)
+{
+    struct kmer_worker *worker = arg;
+    struct kmer_job *job = worker->job;
+    struct kmer_batch *batch;
+    char *upto;
+
+    while (1){
+        pthread_mutex_lock(&job->lock);
+        while (!job->invalid && job->claimed == job->read && !job->done){
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        if (job->invalid || job->claimed == job->read){
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        batch = &job->batches[job->claimed % KMER_QUEUE_BATCHES];
+        job->claimed++;
+        pthread_mutex_unlock(&job->lock);
+
+        for (int i = 0; i < batch->num_records; i++){
+            count_sequence(worker, job->k, batch->records[i].sequence,
+                           batch->records[i].sequence_len);
+        }
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = BATCH_COUNTED;
+        upto = NULL;
+        batch = &job->batches[job->retired % KMER_QUEUE_BATCHES];
+        while (job->retired < job->read && batch->state == BATCH_COUNTED){
+            batch->state = BATCH_FREE;
+            upto = batch->end;
+            job->retired++;
+            batch = &job->batches[job->retired % KMER_QUEUE_BATCHES];
+        }
+        if (upto != NULL){
+            release_genfile_input(job->input, upto);
+            pthread_cond_broadcast(&job->cond);
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+    for (int s = 0; s < job->num_shards; s++){
+        flush_bucket(worker, s);
+    }
+    return NULL;
+}
+
+static int compare_kmer(const void *a, const void *b)
+{
+    const struct kmer_count *x = a;
+    const struct kmer_count *y = b;
+    return (x->kmer > y->kmer) - (x->kmer < y->kmer);
+}
+
+static int compare_count(const void *a, const void *b)
+{
+    const struct kmer_count *x = a;
+    const struct kmer_count *y = b;
+    if (x->count != y->count){
+        return (x->count < y->count) - (x->count > y->count);
+    }
+    return compare_kmer(a, b);
+}
+
+/* Move the entry at i of the heap of n entries down until neither child
+ * sorts after it by compare_count, so the entry that sorts last is at 0.
+ */
+static void sift_down(struct kmer_count *heap, size_t n, size_t i)
+{
+    struct kmer_count entry = heap[i];
+    size_t child;
+
+    while ((child = 2 * i + 1) < n){
+        if (child + 1 < n && compare_count(&heap[child + 1], &heap[child]) > 0){
+            child++;
+        }
+        if (compare_count(&heap[child], &entry) <= 0){
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+/* Move the top entries of counts that sort first by compare_count to its
+ * front, in order, using a heap of top entries rather than sorting all n.
+ */
+static void select_top(struct kmer_count *counts, size_t n, size_t top)
+{
+    for (size_t i = top / 2; i-- > 0;){
+        sift_down(counts, top, i);
+    }
+    for (size_t i = top; i < n; i++){
+        if (compare_count(&counts[i], &counts[0]) < 0){
+            counts[0] = counts[i];
+            sift_down(counts, top, 0);
+        }
+    }
+    qsort(counts, top, sizeof(struct kmer_count), compare_count);
+}
+
+/* Pack the used slots of the shards this worker finishes to the front of
+ * their tables and sort them there: by k-mer, or with job->top > 0 just
+ * the job->top that sort first by compare_count. Worker i finishes shards
+ * i, i + num_threads, ...
+ */
+static void *kmer_finish_main(void *arg)
+{
+    struct kmer_worker *worker = arg;
+    struct kmer_job *job = worker->job;
+    struct kmer_shard *shard;
+    size_t n;
+
+    for (int s = worker->index; s < job->num_shards; s += job->num_threads){
+        shard = &job->shards[s];
+        shard->counts = shard->table.slots;
+        n = 0;
+        for (size_t j = 0; j < shard->table.capacity; j++){
+            if (shard->counts[j].kmer != KMER_EMPTY){
+                shard->counts[n++] = shard->counts[j];
+            }
+        }
+        if (job->top > 0){
+            shard->size = (size_t)job->top < n ? (size_t)job->top : n;
+            select_top(shard->counts, n, shard->size);
+        }
+        else {
+            shard->size = n;
+            qsort(shard->counts, n, sizeof(struct kmer_count), compare_kmer);
+        }
+    }
+    return NULL;
+}
+
+/* Write the k-mers of the num_runs runs as "<k-mer> <count>" lines, in
+ * k-mer order. Run r is the lengths[r] entries at runs[r], sorted by
+ * k-mer, and no k-mer is in two runs; a single run is written in the order
+ * it is in. The runs are the shards, so there are few of them, and the
+ * next line is found by looking at the head of each.
+ */
+static void write_kmers(struct kmer_count **runs, size_t *lengths,
+                        int num_runs, int k)
+{
+    struct out_buf out;
+    struct out_sink *sink;
+    struct kmer_count *next;
+    size_t heads[num_runs];
+    char *line;
+    int r;
+
+    init_out_buf(&out);
+    sink = open_out_sink(STDOUT_FILENO);
+    for (r = 0; r < num_runs; r++){
+        heads[r] = 0;
+    }
+    while (1){
+        next = NULL;
+        for (int i = 0; i < num_runs; i++){
+            if (heads[i] < lengths[i]
+                && (next == NULL || runs[i][heads[i]].kmer < next->kmer)){
+                next = &runs[i][heads[i]];
+                r = i;
+            }
+        }
+        if (next == NULL){
+            break;
+        }
+        heads[r]++;
+        line = reserve_out_buf(&out, k + 1);
+        for (int j = 0; j < k; j++){
+            line[j] = "ACGT"[(next->kmer >> (2 * (k - 1 - j))) & 3];
+        }
+        line[k] = ' ';
+        out.len += k + 1;
+        append_int_out_buf(&out, next->count);
+        append_out_buf(&out, "\n", 1);
+        if (out.len >= OUT_SINK_SIZE){
+            submit_out_buf(sink, &out);
+        }
+    }
+    submit_out_buf(sink, &out);
+    close_out_sink(sink);
+    free_out_buf(&out);
+}
+
+/* Count the canonical k-mers of the sequences in filename and print them.
+ * filename is read as generate_molecules_from_file reads it: records of
+ * "<length> <sequence> <mode>" lines, FASTA or FASTQ. The mode of a record
+ * is ignored, since a k-mer and its reverse complement are counted as one,
+ * and the length is not checked. Characters other than A, C, G and T (in
+ * either case) are skipped, and no k-mer spans one.
+ *
+ * A k-mer is printed as the smaller of itself and its reverse complement,
+ * in the order A < C < G < T, followed by its count:
+ *     <k-mer> <count>
+ * With opts->top > 0 only the opts->top most frequent k-mers are printed,
+ * most frequent first; otherwise every k-mer is printed in sorted order.
+ *
+ * A reader thread parses the records into batches, and opts->num_threads
+ * threads take the batches and count their k-mers into as many shards, each k-mer into the shard its
+ * hash picks. A thread gathers the k-mers of each shard in a bucket of its
+ * own and adds a full bucket to the shard under the shard's lock. The
+ * shards are then sorted on as many threads and merged as they are
+ * written; with opts->top > 0 each shard gives its opts->top most
+ * frequent k-mers, and the most frequent of those are printed.
+ * The program exits with an error if k is not between 1 and 32 or the
+ * file cannot be parsed.
+ */
+void count_kmers(int k, char *filename, struct kmer_options *opts)
+{
+    int num_threads = opts->num_threads;
+    struct genfile_input input;
+    struct kmer_job job;
+    struct kmer_worker workers[num_threads];
+    pthread_t reader;
+    pthread_t threads[num_threads];
+    struct kmer_count *runs[num_threads];
+    size_t lengths[num_threads];
+    struct kmer_count *top = NULL;
+    size_t n = 0;
+    int i;
+
+    if (k < 1 || k > 32){
+        fprintf(stderr, "kmers: k must be between 1 and 32\n");
+        exit(1);
+    }
+    open_genfile_input(filename, &input);
+    job.k = k;
+    job.num_threads = num_threads;
+    job.num_shards = num_threads;
+    job.top = opts->top;
+    job.input = &input;
+    init_scanner(&job.scanner, &input, 0);
+    job.read = 0;
+    job.claimed = 0;
+    job.retired = 0;
+    job.done = 0;
+    job.invalid = 0;
+    for (i = 0; i < KMER_QUEUE_BATCHES; i++){
+        job.batches[i].state = BATCH_FREE;
+    }
+    job.shards = malloc(job.num_shards * sizeof(struct kmer_shard));
+    if (job.shards == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    if (pthread_create(&reader, NULL, kmer_reader_main, &job) != 0){
+        perror("pthread_create");
+        exit(1);
+    }
+    for (i = 0; i < job.num_shards; i++){
+        init_kmer_table(&job.shards[i].table, KMER_TABLE_SIZE);
+        pthread_mutex_init(&job.shards[i].lock, NULL);
+    }
+    for (i = 0; i < num_threads; i++){
+        workers[i].job = &job;
+        workers[i].index = i;
+        workers[i].buckets = malloc((size_t)job.num_shards * KMER_BUCKET_SIZE
+                                    * sizeof(uint64_t));
+        workers[i].bucket_len = calloc(job.num_shards, sizeof(int));
+        if (workers[i].buckets == NULL || workers[i].bucket_len == NULL){
+            perror("malloc");
+            exit(1);
+        }
+        if (pthread_create(&threads[i], NULL, kmer_worker_main, &workers[i]) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    pthread_join(reader, NULL);
+    for (i = 0; i < num_threads; i++){
+        pthread_join(threads[i], NULL);
+        free(workers[i].buckets);
+        free(workers[i].bucket_len);
+    }
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    close_genfile_input(&input);
+    if (job.invalid){
+        fprintf(stderr, "kmers: %s: malformed record\n", filename);
+        exit(1);
+    }
+
+    for (i = 0; i < num_threads; i++){
+        if (pthread_create(&threads[i], NULL, kmer_finish_main, &workers[i]) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (i = 0; i < num_threads; i++){
+        pthread_join(threads[i], NULL);
+    }
+    for (i = 0; i < job.num_shards; i++){
+        runs[i] = job.shards[i].counts;
+        lengths[i] = job.shards[i].size;
+        n += lengths[i];
+    }
+
+    fflush(stdout);
+    if (opts->top > 0 && job.num_shards > 1){
+        // the most frequent k-mers overall are among the most frequent of each shard
+        top = malloc(n * sizeof(struct kmer_count));
+        if (top == NULL && n > 0){
+            perror("malloc");
+            exit(1);
+        }
+        n = 0;
+        for (i = 0; i < job.num_shards; i++){
+            memcpy(top + n, runs[i], lengths[i] * sizeof(struct kmer_count));
+            n += lengths[i];
+        }
+        lengths[0] = (size_t)opts->top < n ? (size_t)opts->top : n;
+        select_top(top, n, lengths[0]);
+        write_kmers(&top, lengths, 1, k);
+    }
+    else {
+        write_kmers(runs, lengths, job.num_shards, k);
+    }
+    for (i = 0; i < job.num_shards; i++){
+        free_kmer_table(&job.shards[i].table);
+        pthread_mutex_destroy(&job.shards[i].lock);
+    }
+    free(top);
+    free(job.shards);
+}
@@ -1,24 +1,105 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
 #include "seqbot_helpers.h"
+#include "seqbot_bin.h"
+#include "seqbot_batch.h"
+
+static struct option melt_option[] = {
+    {"tm-model", required_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0}
+};
+
+static struct option format_option[] = {
+    {"format", required_argument, NULL, 'f'},
+    {NULL, 0, NULL, 0}
+};
+
+static struct option profile_option[] = {
+    {"tm-min", required_argument, NULL, 't'},
+    {"tm-max", required_argument, NULL, 'T'},
+    {NULL, 0, NULL, 0}
+};
+
+static struct option genall_option[] = {
+    {"format", required_argument, NULL, 'f'},
+    {"tm-min", required_argument, NULL, 't'},
+    {"tm-max", required_argument, NULL, 'T'},
+    {"shard", required_argument, NULL, 's'},
+    {"resume-from", required_argument, NULL, 'r'},
+    {NULL, 0, NULL, 0}
+};
+
+/* Return the output format named by value, the argument to --format of task.
+ */
+static enum output_format parse_format(char *task, char *value)
+{
+    if(strcmp(value, "text") == 0) {
+        return FORMAT_TEXT;
+    }
+    if(strcmp(value, "bin") == 0) {
+        return FORMAT_BIN;
+    }
+    fprintf(stderr, "%s: --format must be text or bin\n", task);
+    exit(EXIT_FAILURE);
+}
 
 int main(int argc, char** argv)
 {
     if(argc < 3) {
         fprintf(stderr, "usage: seqbot [ <task>  <input> \n");
         fprintf(stderr, "Perform one of the following tasks:\n");
-        fprintf(stderr, "    melt <sequence> - compute the melting point of sequence\n");
-        fprintf(stderr, "    print <sequence> - print instructions for for sequence\n");
-        fprintf(stderr, "    genall <size> - generate and print instructions for all possible molecules of a given size\n");
-        fprintf(stderr, "    genfile <file> - print the instructions for each of the sequences in file\n");
+        fprintf(stderr, "    melt [--tm-model=nn] <sequence> - compute the melting point of sequence\n");
+        fprintf(stderr, "        (--tm-model=nn uses the nearest-neighbor model instead of 2 per A/T and 4 per C/G)\n");
+        fprintf(stderr, "    print [--format=bin] <sequence> - print instructions for for sequence\n");
+        fprintf(stderr, "    genall [-j threads] [--format=bin] [--tm-min t] [--tm-max t] [--shard i/n] [--resume-from sequence] <size> - generate and print instructions for all possible molecules of a given size\n");
+        fprintf(stderr, "        (--shard prints only the i-th of n equal parts, and --resume-from only the molecules after the one given)\n");
+        fprintf(stderr, "    genfile [-j threads] [-m mode] [-c cache MB] [--format=bin] <file> - print the instructions for each of the sequences in file\n");
+        fprintf(stderr, "        (FASTA and FASTQ files are recognised, and -m sets the mode of their sequences)\n");
+        fprintf(stderr, "        (the file may be gzip compressed)\n");
+        fprintf(stderr, "        (-c caches the output of repeated sequences in up to that many MB)\n");
+        fprintf(stderr, "    kmers [-j threads] [-n top] <k> <file> - count the k-mers of the sequences in file\n");
+        fprintf(stderr, "    profile [--tm-min t] [--tm-max t] <window> <file> - print the melting temperature of every window of the sequences in file\n");
+        fprintf(stderr, "    stats <size> - count the molecules genall would print by temperature and number of runs\n");
+        fprintf(stderr, "    serve [-j threads] <socket> - answer melt, print and genfile requests sent to a Unix domain socket, one per line\n");
+        fprintf(stderr, "    decode <file> - convert binary instructions in file back to text\n");
         exit(EXIT_FAILURE);
     }
     
     if(strcmp(argv[1], "melt") == 0) {
-        char *test_sequence = argv[2];
-        int length = strlen(test_sequence);
-        int t = calculate_melting_temperature(test_sequence, length);
+        int nearest_neighbor = 0;
+        int opt;
+        while((opt = getopt_long(argc - 1, argv + 1, "", melt_option, NULL)) != -1) {
+            if(opt != 'm' || (strcmp(optarg, "nn") != 0 && strcmp(optarg, "simple") != 0)) {
+                fprintf(stderr, "usage: seqbot melt [--tm-model=nn] <sequence>\n");
+                exit(EXIT_FAILURE);
+            }
+            nearest_neighbor = strcmp(optarg, "nn") == 0;
+        }
+        if(optind + 1 >= argc) {
+            fprintf(stderr, "usage: seqbot melt [--tm-model=nn] <sequence>\n");
+            exit(EXIT_FAILURE);
+        }
+        char *test_sequence = argv[optind + 1];
+        // the sequence is a batch of one
+        size_t offsets[2] = {0, strlen(test_sequence)};
+        struct seqbot_batch batch = {.arena = test_sequence, .offsets = offsets, .count = 1};
+        if(nearest_neighbor) {
+            double tm;
+            batch_nn_melting_temperatures(&batch, &tm);
+            if(isnan(tm)) {
+                printf("INVALID SEQUENCE, %s", test_sequence);
+                return 1;
+            }
+            printf("The melting temperature of %s is %.1f\n", test_sequence, tm);
+            return 0;
+        }
+        int t;
+        batch_melting_temperatures(&batch, &t);
         if(t == -1) {
             printf("INVALID SEQUENCE, %s", test_sequence);
             return 1;
@@ -27,16 +108,203 @@ int main(int argc, char** argv)
         }
 
     } else if(strcmp(argv[1], "print") == 0) {
-        char *test_sequence = argv[2];
+        enum output_format format = FORMAT_TEXT;
+        int opt;
+        while((opt = getopt_long(argc - 1, argv + 1, "", format_option, NULL)) != -1) {
+            if(opt != 'f') {
+                fprintf(stderr, "usage: seqbot print [--format=bin] <sequence>\n");
+                exit(EXIT_FAILURE);
+            }
+            format = parse_format("print", optarg);
+        }
+        if(optind + 1 >= argc) {
+            fprintf(stderr, "usage: seqbot print [--format=bin] <sequence>\n");
+            exit(EXIT_FAILURE);
+        }
+        char *test_sequence = argv[optind + 1];
         int length = strlen(test_sequence);
-        print_instructions(test_sequence, length);
+        print_instructions_with_format(test_sequence, length, format);
 
     } else if(strcmp(argv[1], "genall") == 0) {
-        int size = atoi(argv[2]);
-        generate_all_molecules(size);
+        struct genall_options opts = {.num_threads = 1, .format = FORMAT_TEXT,
+                                      .tm_window = 0, .tm_min = 0, .tm_max = INT_MAX,
+                                      .shard = 1, .num_shards = 1, .resume_from = NULL};
+        char end;
+        // parse the options that follow the task name
+        int opt;
+        while((opt = getopt_long(argc - 1, argv + 1, "j:", genall_option, NULL)) != -1) {
+            switch(opt) {
+                case 'j':
+                    opts.num_threads = atoi(optarg);
+                    if(opts.num_threads < 1) {
+                        fprintf(stderr, "genall: -j must be at least 1\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'f':
+                    opts.format = parse_format("genall", optarg);
+                    break;
+                case 't':
+                    opts.tm_window = 1;
+                    opts.tm_min = atoi(optarg);
+                    break;
+                case 'T':
+                    opts.tm_window = 1;
+                    opts.tm_max = atoi(optarg);
+                    break;
+                case 's':
+                    if(sscanf(optarg, "%d/%d%c", &opts.shard, &opts.num_shards, &end) != 2
+                       || opts.shard < 1 || opts.shard > opts.num_shards) {
+                        fprintf(stderr, "genall: --shard must be i/n with i from 1 to n\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'r':
+                    opts.resume_from = optarg;
+                    break;
+                default:
+                    fprintf(stderr, "usage: seqbot genall [-j threads] [--format=bin] [--tm-min t] [--tm-max t] [--shard i/n] [--resume-from sequence] <size>\n");
+                    exit(EXIT_FAILURE);
+            }
+        }
+        if(optind + 1 >= argc) {
+            fprintf(stderr, "usage: seqbot genall [-j threads] [--format=bin] [--tm-min t] [--tm-max t] [--shard i/n] [--resume-from sequence] <size>\n");
+            exit(EXIT_FAILURE);
+        }
+        int size = atoi(argv[optind + 1]);
+        generate_all_molecules_with_options(size, &opts);
 
     } else if(strcmp(argv[1], "genfile") == 0) {
-        generate_molecules_from_file(argv[2]);
+        struct genfile_options opts = {.num_threads = 1, .format = FORMAT_TEXT,
+                                       .default_mode = 0, .cache_size = 0};
+        // parse the options that follow the task name
+        int opt;
+        while((opt = getopt_long(argc - 1, argv + 1, "j:m:c:", format_option, NULL)) != -1) {
+            switch(opt) {
+                case 'm':
+                    opts.default_mode = atoi(optarg);
+                    if(opts.default_mode < 0 || opts.default_mode > 3) {
+                        fprintf(stderr, "genfile: -m must be between 0 and 3\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'j':
+                    opts.num_threads = atoi(optarg);
+                    if(opts.num_threads < 1) {
+                        fprintf(stderr, "genfile: -j must be at least 1\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'c':
+                    if(atol(optarg) < 0) {
+                        fprintf(stderr, "genfile: -c must not be negative\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    opts.cache_size = (size_t)atol(optarg) << 20;
+                    break;
+                case 'f':
+                    opts.format = parse_format("genfile", optarg);
+                    break;
+                default:
+                    fprintf(stderr, "usage: seqbot genfile [-j threads] [-m mode] [-c cache MB] [--format=bin] <file>\n");
+                    exit(EXIT_FAILURE);
+            }
+        }
+        if(optind + 1 >= argc) {
+            fprintf(stderr, "usage: seqbot genfile [-j threads] [-m mode] [-c cache MB] [--format=bin] <file>\n");
+            exit(EXIT_FAILURE);
+        }
+        generate_molecules_from_file_with_options(argv[optind + 1], &opts);
+
+    } else if(strcmp(argv[1], "kmers") == 0) {
+        struct kmer_options opts = {.num_threads = 1, .top = 0};
+        // parse the options that follow the task name
+        int opt;
+        while((opt = getopt(argc - 1, argv + 1, "j:n:")) != -1) {
+            switch(opt) {
+                case 'j':
+                    opts.num_threads = atoi(optarg);
+                    if(opts.num_threads < 1) {
+                        fprintf(stderr, "kmers: -j must be at least 1\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case 'n':
+                    opts.top = atol(optarg);
+                    if(opts.top < 1) {
+                        fprintf(stderr, "kmers: -n must be at least 1\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                default:
+                    fprintf(stderr, "usage: seqbot kmers [-j threads] [-n top] <k> <file>\n");
+                    exit(EXIT_FAILURE);
+            }
+        }
+        if(optind + 2 >= argc) {
+            fprintf(stderr, "usage: seqbot kmers [-j threads] [-n top] <k> <file>\n");
+            exit(EXIT_FAILURE);
+        }
+        count_kmers(atoi(argv[optind + 1]), argv[optind + 2], &opts);
+
+    } else if(strcmp(argv[1], "profile") == 0) {
+        struct profile_options opts = {.tm_min = INT_MIN, .tm_max = INT_MAX};
+        // parse the options that follow the task name
+        int opt;
+        while((opt = getopt_long(argc - 1, argv + 1, "", profile_option, NULL)) != -1) {
+            switch(opt) {
+                case 't':
+                    opts.tm_min = atoi(optarg);
+                    break;
+                case 'T':
+                    opts.tm_max = atoi(optarg);
+                    break;
+                default:
+                    fprintf(stderr, "usage: seqbot profile [--tm-min t] [--tm-max t] <window> <file>\n");
+                    exit(EXIT_FAILURE);
+            }
+        }
+        if(optind + 2 >= argc) {
+            fprintf(stderr, "usage: seqbot profile [--tm-min t] [--tm-max t] <window> <file>\n");
+            exit(EXIT_FAILURE);
+        }
+        print_melting_profile(atoi(argv[optind + 1]), argv[optind + 2], &opts);
+
+    } else if(strcmp(argv[1], "stats") == 0) {
+        print_genall_stats(atoi(argv[2]));
+
+    } else if(strcmp(argv[1], "serve") == 0) {
+        struct serve_options opts = {.num_threads = 1};
+        // parse the options that follow the task name
+        int opt;
+        while((opt = getopt(argc - 1, argv + 1, "j:")) != -1) {
+            if(opt != 'j') {
+                fprintf(stderr, "usage: seqbot serve [-j threads] <socket>\n");
+                exit(EXIT_FAILURE);
+            }
+            opts.num_threads = atoi(optarg);
+            if(opts.num_threads < 1) {
+                fprintf(stderr, "serve: -j must be at least 1\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if(optind + 1 >= argc) {
+            fprintf(stderr, "usage: seqbot serve [-j threads] <socket>\n");
+            exit(EXIT_FAILURE);
+        }
+        serve_requests(argv[optind + 1], &opts);
+
+    } else if(strcmp(argv[1], "decode") == 0) {
+        FILE *in = strcmp(argv[2], "-") == 0 ? stdin : fopen(argv[2], "rb");
+        if(in == NULL) {
+            perror(argv[2]);
+            exit(EXIT_FAILURE);
+        }
+        if(decode_instructions(in, STDOUT_FILENO) != 0) {
+            fprintf(stderr, "decode: %s is not a valid instruction stream\n", argv[2]);
+            exit(EXIT_FAILURE);
+        }
+        fclose(in);
 
     } else {
         fprintf(stderr, "task not recognized: %s\n", argv[1]);
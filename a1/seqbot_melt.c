@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include "seqbot_melt.h"
+
+#ifdef SEQBOT_X86
+#include <immintrin.h>
+#endif
+
+const unsigned char melt_weight[256] = {
+    ['A'] = 2, ['T'] = 2, ['C'] = 4, ['G'] = 4
+};
+
+/* Scalar kernel: one table lookup per base.
+ */
+int melt_scalar(const char *sequence, int sequence_length)
+{
+    int ret = 0;
+    int w;
+    if (sequence_length <= 0){
+        return -1;
+    }
+    for (int i = 0; i < sequence_length; i++){
+        w = melt_weight[(unsigned char)sequence[i]];
+        if (w == 0){
+            return -1;
+        }
+        ret += w;
+    }
+    return ret;
+}
+
+#ifdef SEQBOT_X86
+
+/* SSE2 kernel: compare 16 bases at a time against each base letter.
+ * A block is valid if every byte matched one of the four letters, and the
+ * G/C count of the block is the popcount of the C|G match mask.
+ * The temperature is then 2 * length + 2 * (number of G/C).
+ */
+__attribute__((target("sse2")))
+int melt_sse2(const char *sequence, int sequence_length)
+{
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i t = _mm_set1_epi8('T');
+    int i = 0;
+    int gc = 0;
+    int tail;
+
+    if (sequence_length <= 0){
+        return -1;
+    }
+    for (; i + 16 <= sequence_length; i += 16){
+        __m128i v = _mm_loadu_si128((const __m128i *)(sequence + i));
+        __m128i is_gc = _mm_or_si128(_mm_cmpeq_epi8(v, c), _mm_cmpeq_epi8(v, g));
+        __m128i is_at = _mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, t));
+        if (_mm_movemask_epi8(_mm_or_si128(is_gc, is_at)) != 0xFFFF){
+            return -1;
+        }
+        gc += __builtin_popcount(_mm_movemask_epi8(is_gc));
+    }
+    if (i == sequence_length){
+        return 2 * sequence_length + 2 * gc;
+    }
+    tail = melt_scalar(sequence + i, sequence_length - i);
+    if (tail < 0){
+        return -1;
+    }
+    return 2 * i + 2 * gc + tail;
+}
+
+/* AVX2 kernel: the same as melt_sse2 but 32 bases at a time.
+ */
+__attribute__((target("avx2")))
+int melt_avx2(const char *sequence, int sequence_length)
+{
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i c = _mm256_set1_epi8('C');
+    const __m256i g = _mm256_set1_epi8('G');
+    const __m256i t = _mm256_set1_epi8('T');
+    int i = 0;
+    int gc = 0;
+    int tail;
+
+    if (sequence_length <= 0){
+        return -1;
+    }
+    for (; i + 32 <= sequence_length; i += 32){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(sequence + i));
+        __m256i is_gc = _mm256_or_si256(_mm256_cmpeq_epi8(v, c), _mm256_cmpeq_epi8(v, g));
+        __m256i is_at = _mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, t));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_or_si256(is_gc, is_at)) != 0xFFFFFFFFu){
+            return -1;
+        }
+        gc += __builtin_popcount((unsigned)_mm256_movemask_epi8(is_gc));
+    }
+    if (i == sequence_length){
+        return 2 * sequence_length + 2 * gc;
+    }
+    tail = melt_sse2(sequence + i, sequence_length - i);
+    if (tail < 0){
+        return -1;
+    }
+    return 2 * i + 2 * gc + tail;
+}
+
+int cpu_has_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+int cpu_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+int cpu_has_sse2(void)
+{
+    return 0;
+}
+
+int cpu_has_avx2(void)
+{
+    return 0;
+}
+
+#endif
+
+/* Pick the kernel on the first call and replace the pointer, so later calls
+ * go straight to the chosen kernel. Threads may race on the first call; they
+ * all pick the same kernel, and the pointer is accessed atomically.
+ */
+static int melt_resolve(const char *sequence, int sequence_length);
+static melt_fn melt_kernel = melt_resolve;
+
+static int melt_resolve(const char *sequence, int sequence_length)
+{
+    melt_fn chosen = melt_scalar;
+#ifdef SEQBOT_X86
+    if (cpu_has_avx2()){
+        chosen = melt_avx2;
+    }
+    else if (cpu_has_sse2()){
+        chosen = melt_sse2;
+    }
+#endif
+    __atomic_store_n(&melt_kernel, chosen, __ATOMIC_RELAXED);
+    return chosen(sequence, sequence_length);
+}
+
+int fast_melting_temperature(const char *sequence, int sequence_length)
+{
+    return __atomic_load_n(&melt_kernel, __ATOMIC_RELAXED)(sequence, sequence_length);
+}
@@ -0,0 +1,28 @@
+#ifndef SEQBOT_MELT
+#define SEQBOT_MELT
+
+/* Melting temperature kernels over ASCII sequences.
+ * Every kernel validates the whole buffer and returns the same result as
+ * calculate_melting_temperature: 2 per A/T, 4 per C/G, or -1 if the
+ * sequence is empty or contains any other character.
+ */
+typedef int (*melt_fn)(const char *sequence, int sequence_length);
+
+// weight of each base in the melting temperature, 0 for invalid characters
+extern const unsigned char melt_weight[256];
+
+int melt_scalar(const char *sequence, int sequence_length);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SEQBOT_X86
+int melt_sse2(const char *sequence, int sequence_length);
+int melt_avx2(const char *sequence, int sequence_length);
+#endif
+
+int cpu_has_sse2(void);
+int cpu_has_avx2(void);
+
+// the melting temperature using the fastest kernel this CPU supports
+int fast_melting_temperature(const char *sequence, int sequence_length);
+
+#endif
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <math.h>
+#include "seqbot_nn.h"
+#include "seqbot_revcomp.h"
+
+#ifdef SEQBOT_X86
+#include <immintrin.h>
+#endif
+
+// the gas constant in cal/(K mol)
+#define NN_GAS_CONSTANT 1.9872
+
+// the 2-bit code of a base letter; the complement of a base is its code ^ 2
+#define NN_BASE_CODE(c) (((unsigned char)(c) >> 1) & 3)
+
+/* -dH of each stack in units of 100 cal/mol, and -dS in units of
+ * 0.1 cal/(K mol) less 100 so that every entry fits in a byte. The index
+ * is the 4-bit code of the pair, with the bases in the order A C T G.
+ */
+static const unsigned char nn_enthalpy[16] = {
+    79, 84, 72, 78,      // AA AC AT AG
+    85, 80, 78, 106,     // CA CC CT CG
+    72, 82, 79, 85,      // TA TC TT TG
+    82, 98, 84, 80       // GA GC GT GG
+};
+static const unsigned char nn_entropy[16] = {
+    122, 124, 104, 110,  // AA AC AT AG
+    127, 99, 110, 172,   // CA CC CT CG
+    113, 122, 122, 127,  // TA TC TT TG
+    122, 144, 124, 99    // GA GC GT GG
+};
+
+/* Add the stacks of the pairs that start in the first sequence_length - 1
+ * bases to sums, after checking every base. Return -1 if a character is
+ * not a base.
+ */
+static int add_stacks(const char *sequence, int sequence_length,
+                      struct nn_sums *sums)
+{
+    int code;
+
+    for (int i = 0; i < sequence_length; i++){
+        if (melt_weight[(unsigned char)sequence[i]] == 0){
+            return -1;
+        }
+    }
+    for (int i = 1; i < sequence_length; i++){
+        code = NN_BASE_CODE(sequence[i - 1]) << 2 | NN_BASE_CODE(sequence[i]);
+        sums->enthalpy += nn_enthalpy[code];
+        sums->entropy += nn_entropy[code] + 100;
+    }
+    return 0;
+}
+
+/* Scalar kernel: two table lookups per pair.
+ */
+int nn_scalar(const char *sequence, int sequence_length, struct nn_sums *sums)
+{
+    sums->enthalpy = 0;
+    sums->entropy = 0;
+    if (sequence_length < 2){
+        return -1;
+    }
+    return add_stacks(sequence, sequence_length, sums);
+}
+
+#ifdef SEQBOT_X86
+
+/* SSSE3 kernel: 16 pairs at a time.
+ * The block of 16 bases at i and the one at i + 1 give the first and
+ * second base of 16 pairs. Their codes are shifted out of each byte and
+ * combined into 16 pair codes, which look up the two tables with one
+ * shuffle each. psadbw adds the 16 looked-up bytes into two 64-bit lanes.
+ * A block is valid if every byte of the one at i is a base letter; the
+ * last base is checked with the next block, or by add_stacks with the rest.
+ */
+__attribute__((target("ssse3")))
+int nn_ssse3(const char *sequence, int sequence_length, struct nn_sums *sums)
+{
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i t = _mm_set1_epi8('T');
+    const __m128i two_bits = _mm_set1_epi8(3);
+    const __m128i enthalpy = _mm_loadu_si128((const __m128i *)nn_enthalpy);
+    const __m128i entropy = _mm_loadu_si128((const __m128i *)nn_entropy);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i enthalpy_sum = zero;
+    __m128i entropy_sum = zero;
+    __m128i first;
+    __m128i second;
+    __m128i valid;
+    __m128i code;
+    long long lanes[2];
+    int i = 0;
+
+    sums->enthalpy = 0;
+    sums->entropy = 0;
+    if (sequence_length < 2){
+        return -1;
+    }
+    for (; i + 17 <= sequence_length; i += 16){
+        first = _mm_loadu_si128((const __m128i *)(sequence + i));
+        second = _mm_loadu_si128((const __m128i *)(sequence + i + 1));
+        valid = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(first, a), _mm_cmpeq_epi8(first, c)),
+                             _mm_or_si128(_mm_cmpeq_epi8(first, g), _mm_cmpeq_epi8(first, t)));
+        if (_mm_movemask_epi8(valid) != 0xFFFF){
+            return -1;
+        }
+        first = _mm_and_si128(_mm_srli_epi16(first, 1), two_bits);
+        second = _mm_and_si128(_mm_srli_epi16(second, 1), two_bits);
+        code = _mm_or_si128(_mm_slli_epi16(first, 2), second);
+        enthalpy_sum = _mm_add_epi64(enthalpy_sum,
+                                     _mm_sad_epu8(_mm_shuffle_epi8(enthalpy, code), zero));
+        entropy_sum = _mm_add_epi64(entropy_sum,
+                                    _mm_sad_epu8(_mm_shuffle_epi8(entropy, code), zero));
+    }
+    _mm_storeu_si128((__m128i *)lanes, enthalpy_sum);
+    sums->enthalpy = lanes[0] + lanes[1];
+    _mm_storeu_si128((__m128i *)lanes, entropy_sum);
+    sums->entropy = lanes[0] + lanes[1] + 100L * i;
+    return add_stacks(sequence + i, sequence_length - i, sums);
+}
+
+#endif
+
+/* Pick the kernel on the first call and replace the pointer, as
+ * fast_melting_temperature does.
+ */
+static int nn_resolve(const char *sequence, int sequence_length,
+                      struct nn_sums *sums);
+static nn_fn nn_kernel = nn_resolve;
+
+static int nn_resolve(const char *sequence, int sequence_length,
+                      struct nn_sums *sums)
+{
+    nn_fn chosen = nn_scalar;
+#ifdef SEQBOT_X86
+    if (cpu_has_ssse3()){
+        chosen = nn_ssse3;
+    }
+#endif
+    __atomic_store_n(&nn_kernel, chosen, __ATOMIC_RELAXED);
+    return chosen(sequence, sequence_length, sums);
+}
+
+int nn_stack_sums(const char *sequence, int sequence_length,
+                  struct nn_sums *sums)
+{
+    return __atomic_load_n(&nn_kernel, __ATOMIC_RELAXED)(sequence, sequence_length, sums);
+}
+
+/* Return 1 if sequence is its own reverse complement.
+ */
+static int is_self_complementary(const char *sequence, int sequence_length)
+{
+    for (int i = 0, j = sequence_length - 1; i < j; i++, j--){
+        if (NN_BASE_CODE(sequence[i]) != (NN_BASE_CODE(sequence[j]) ^ 2)){
+            return 0;
+        }
+    }
+    return sequence_length % 2 == 0;
+}
+
+/* Set *temperature to the melting temperature of sequence in degrees C by
+ * the nearest-neighbor model, and return 0, or return -1 if the sequence
+ * is invalid for nn_stack_sums.
+ *
+ * To the stacks are added the initiation of each end (0.1 kcal/mol and
+ * -2.8 cal/(K mol) for G/C, 2.3 kcal/mol and 4.1 cal/(K mol) for A/T),
+ * the salt correction of 0.368 ln[Na+] cal/(K mol) per stack and, for a
+ * self-complementary sequence, the symmetry correction of -1.4 cal/(K mol).
+ * Then
+ *     Tm = dH / (dS + R ln(CT / x)) - 273.15
+ * where CT is NN_STRAND_CONCENTRATION and x is 4, or 1 for a
+ * self-complementary sequence.
+ */
+int nn_melting_temperature(const char *sequence, int sequence_length,
+                           double *temperature)
+{
+    struct nn_sums sums;
+    double dh;
+    double ds;
+    double strands = NN_STRAND_CONCENTRATION / 4;
+    char ends[2];
+
+    if (nn_stack_sums(sequence, sequence_length, &sums) < 0){
+        return -1;
+    }
+    ends[0] = sequence[0];
+    ends[1] = sequence[sequence_length - 1];
+    dh = -100.0 * sums.enthalpy;
+    ds = -0.1 * sums.entropy;
+    for (int i = 0; i < 2; i++){
+        if (ends[i] == 'C' || ends[i] == 'G'){
+            dh += 100;
+            ds -= 2.8;
+        }
+        else {
+            dh += 2300;
+            ds += 4.1;
+        }
+    }
+    ds += 0.368 * (sequence_length - 1) * log(NN_SODIUM_CONCENTRATION);
+    if (is_self_complementary(sequence, sequence_length)){
+        ds -= 1.4;
+        strands = NN_STRAND_CONCENTRATION;
+    }
+    *temperature = dh / (ds + NN_GAS_CONSTANT * log(strands)) - 273.15;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef SEQBOT_NN
+#define SEQBOT_NN
+
+#include "seqbot_melt.h"
+
+/* Nearest-neighbor melting temperature, with the unified stack parameters
+ * of SantaLucia (1998).
+ *
+ * A base is given a 2-bit code from bits 1 and 2 of its letter, which
+ * differ between 'A', 'C', 'T' and 'G' (0, 1, 2, 3), and each pair of
+ * neighboring bases the 4-bit code (first << 2) | second. The enthalpy and
+ * entropy of every stack are looked up by that code in tables of 16 bytes,
+ * so a vector kernel can look up 16 stacks with one shuffle.
+ *
+ * Every kernel validates the whole buffer and adds up the stacks:
+ *   - enthalpy is the sum of -dH in units of 100 cal/mol
+ *   - entropy is the sum of -dS in units of 0.1 cal/(K mol)
+ * and returns 0, or -1 if the sequence has fewer than 2 bases or contains
+ * characters other than 'A', 'C', 'G', 'T'.
+ */
+struct nn_sums {
+    long enthalpy;
+    long entropy;
+};
+
+typedef int (*nn_fn)(const char *sequence, int sequence_length,
+                     struct nn_sums *sums);
+
+int nn_scalar(const char *sequence, int sequence_length, struct nn_sums *sums);
+
+#ifdef SEQBOT_X86
+int nn_ssse3(const char *sequence, int sequence_length, struct nn_sums *sums);
+#endif
+
+// the stack sums using the fastest kernel this CPU supports
+int nn_stack_sums(const char *sequence, int sequence_length,
+                  struct nn_sums *sums);
+
+/* The conditions the temperature is calculated for, in mol/L: the total
+ * strand concentration and the Na+ concentration.
+ */
+#define NN_STRAND_CONCENTRATION 50e-9
+#define NN_SODIUM_CONCENTRATION 50e-3
+
+// the nearest-neighbor melting temperature in degrees C, or -1 if invalid
+int nn_melting_temperature(const char *sequence, int sequence_length,
+                           double *temperature);
+
+#endif
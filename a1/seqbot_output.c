@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "seqbot_output.h"
+
+/* The state of an output sink.
+ *   - queue holds the queued buffers that are not written yet, queued of
+ *     them from index head on, in the order they were submitted
+ *   - spare holds num_spare empty buffers the sink owns, to hand back for
+ *     the ones submitted
+ *   - submitted and written count the buffers queued and written so far;
+ *     the ticket of a buffer is submitted just after it was queued
+ *   - closing is 1 once the sink is being closed
+ */
+struct out_sink {
+    int fd;
+    struct out_buf queue[OUT_SINK_DEPTH];
+    int head;
+    int queued;
+    struct out_buf spare[OUT_SINK_DEPTH];
+    int num_spare;
+    unsigned long submitted;
+    unsigned long written;
+    int closing;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/* Write all n bytes of data to fd, retrying after short writes and
+ * interrupted calls. Exit the program if the write fails.
+ */
+void write_all(int fd, const char *data, size_t n)
+{
+    ssize_t written;
+    while (n > 0){
+        written = write(fd, data, n);
+        if (written < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            perror("write");
+            exit(1);
+        }
+        data += written;
+        n -= written;
+    }
+}
+
+void init_out_buf(struct out_buf *buf)
+{
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    buf->fixed = 0;
+}
+
+void free_out_buf(struct out_buf *buf)
+{
+    free(buf->data);
+    init_out_buf(buf);
+}
+
+/* Make room for n more bytes at the end of buf and return a pointer to
+ * them. The caller adds the bytes it actually wrote to buf->len.
+ * A fixed buffer without room for them is an error.
+ *
+ * A buffer is grown by moving it to memory aligned to OUT_BUF_ALIGN, so
+ * the large buffers handed to a sink start on a page.
+ */
+char *reserve_out_buf(struct out_buf *buf, size_t n)
+{
+    size_t capacity = buf->capacity > 0 ? buf->capacity : OUT_BUF_ALIGN;
+    char *data;
+    if (buf->len + n <= buf->capacity){
+        return buf->data + buf->len;
+    }
+    if (buf->fixed){
+        fprintf(stderr, "reserve_out_buf: %zu bytes do not fit in a fixed buffer\n", n);
+        exit(1);
+    }
+    while (capacity < buf->len + n){
+        capacity *= 2;
+    }
+    if (posix_memalign((void **)&data, OUT_BUF_ALIGN, capacity) != 0){
+        perror("posix_memalign");
+        exit(1);
+    }
+    if (buf->len > 0){
+        memcpy(data, buf->data, buf->len);
+    }
+    free(buf->data);
+    buf->data = data;
+    buf->capacity = capacity;
+    return buf->data + buf->len;
+}
+
+void append_out_buf(struct out_buf *buf, const char *data, size_t n)
+{
+    memcpy(reserve_out_buf(buf, n), data, n);
+    buf->len += n;
+}
+
+/* Append value to buf in decimal.
+ */
+void append_int_out_buf(struct out_buf *buf, long value)
+{
+    char digits[24];
+    int n = 0;
+    unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    char *p = reserve_out_buf(buf, sizeof(digits));
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    if (value < 0){
+        *p++ = '-';
+        buf->len++;
+    }
+    buf->len += n;
+    while (n > 0){
+        *p++ = digits[--n];
+    }
+}
+
+/* Write the contents of buf to fd and empty it.
+ */
+void flush_out_buf(struct out_buf *buf, int fd)
+{
+    write_all(fd, buf->data, buf->len);
+    buf->len = 0;
+}
+
+/* Write the n buffers of iov to fd with as few writev() calls as it
+ * takes, retrying after short writes and interrupted calls. Exit the
+ * program if the write fails. iov is used up in the process.
+ */
+static void writev_all(int fd, struct iovec *iov, int n)
+{
+    ssize_t written;
+
+    while (n > 0){
+        written = writev(fd, iov, n);
+        if (written < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            perror("writev");
+            exit(1);
+        }
+        while (n > 0 && (size_t)written >= iov->iov_len){
+            written -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0){
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/* Write the buffers handed to sink until it is closed.
+ * Everything queued when the thread wakes up is written with one
+ * writev(), without the lock, so more buffers can be filled and queued
+ * meanwhile. A blocking writev() works the same on files and pipes.
+ * The buffers it owns go back to the spare list once written.
+ */
+static void *out_sink_main(void *arg)
+{
+    struct out_sink *sink = arg;
+    struct iovec iov[OUT_SINK_DEPTH];
+    struct out_buf *buf;
+    int n;
+
+    pthread_mutex_lock(&sink->lock);
+    while (1){
+        while (sink->queued == 0 && !sink->closing){
+            pthread_cond_wait(&sink->cond, &sink->lock);
+        }
+        n = sink->queued;
+        if (n == 0){
+            break;
+        }
+        pthread_mutex_unlock(&sink->lock);
+        for (int i = 0; i < n; i++){
+            buf = &sink->queue[(sink->head + i) % OUT_SINK_DEPTH];
+            iov[i].iov_base = buf->data;
+            iov[i].iov_len = buf->len;
+        }
+        writev_all(sink->fd, iov, n);
+        pthread_mutex_lock(&sink->lock);
+        for (int i = 0; i < n; i++){
+            buf = &sink->queue[sink->head];
+            if (!buf->fixed){
+                buf->len = 0;
+                sink->spare[sink->num_spare++] = *buf;
+            }
+            sink->head = (sink->head + 1) % OUT_SINK_DEPTH;
+        }
+        sink->queued -= n;
+        sink->written += n;
+        pthread_cond_broadcast(&sink->cond);
+    }
+    pthread_mutex_unlock(&sink->lock);
+    return NULL;
+}
+
+/* Start a sink that writes to fd. Anything written to fd before is
+ * written first, so stdio buffers should be flushed beforehand.
+ */
+struct out_sink *open_out_sink(int fd)
+{
+    struct out_sink *sink = malloc(sizeof(struct out_sink));
+
+    if (sink == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    sink->fd = fd;
+    sink->head = 0;
+    sink->queued = 0;
+    sink->num_spare = 0;
+    sink->submitted = 0;
+    sink->written = 0;
+    sink->closing = 0;
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->cond, NULL);
+    if (pthread_create(&sink->thread, NULL, out_sink_main, sink) != 0){
+        perror("pthread_create");
+        exit(1);
+    }
+    return sink;
+}
+
+/* Wait until the queue of sink has room, then add buf to it and return
+ * its ticket. The caller holds the lock.
+ */
+static unsigned long queue_out_buf(struct out_sink *sink, struct out_buf *buf)
+{
+    while (sink->queued == OUT_SINK_DEPTH){
+        pthread_cond_wait(&sink->cond, &sink->lock);
+    }
+    sink->queue[(sink->head + sink->queued) % OUT_SINK_DEPTH] = *buf;
+    sink->queued++;
+    pthread_cond_broadcast(&sink->cond);
+    return ++sink->submitted;
+}
+
+/* Queue the contents of buf to be written, once the queue has room, and
+ * give buf a spare empty buffer in exchange, whose memory is used again.
+ * The writer thread gets the contents of buf without a copy.
+ */
+void submit_out_buf(struct out_sink *sink, struct out_buf *buf)
+{
+    if (buf->len == 0){
+        return;
+    }
+    pthread_mutex_lock(&sink->lock);
+    queue_out_buf(sink, buf);
+    if (sink->num_spare > 0){
+        *buf = sink->spare[--sink->num_spare];
+    }
+    else {
+        init_out_buf(buf);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Queue the n bytes at data to be written, once the queue has room, and
+ * return a ticket for wait_out_sink. The bytes are written where they are,
+ * so the caller must leave them alone until the ticket has been waited for.
+ */
+unsigned long submit_out_data(struct out_sink *sink, const char *data, size_t n)
+{
+    struct out_buf buf = {.data = (char *)data, .len = n, .capacity = n, .fixed = 1};
+    unsigned long ticket;
+
+    pthread_mutex_lock(&sink->lock);
+    ticket = n == 0 ? sink->submitted : queue_out_buf(sink, &buf);
+    pthread_mutex_unlock(&sink->lock);
+    return ticket;
+}
+
+/* Wait until everything submitted to sink up to the one that returned
+ * ticket has been written. A ticket of 0 is never waited for.
+ */
+void wait_out_sink(struct out_sink *sink, unsigned long ticket)
+{
+    pthread_mutex_lock(&sink->lock);
+    while (sink->written < ticket){
+        pthread_cond_wait(&sink->cond, &sink->lock);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Wait for everything handed to sink to be written, then free it. Output
+ * written to the file descriptor afterwards, such as INVALID SEQUENCE
+ * before the program exits, follows all of it.
+ */
+void close_out_sink(struct out_sink *sink)
+{
+    pthread_mutex_lock(&sink->lock);
+    sink->closing = 1;
+    pthread_cond_broadcast(&sink->cond);
+    pthread_mutex_unlock(&sink->lock);
+    pthread_join(sink->thread, NULL);
+    for (int i = 0; i < sink->num_spare; i++){
+        free_out_buf(&sink->spare[i]);
+    }
+    pthread_cond_destroy(&sink->cond);
+    pthread_mutex_destroy(&sink->lock);
+    free(sink);
+}
@@ -0,0 +1,60 @@
+#ifndef SEQBOT_OUTPUT
+#define SEQBOT_OUTPUT
+
+#include <stddef.h>
+
+// a buffer is handed to an output sink once it holds this many bytes
+#define OUT_SINK_SIZE (1 << 20)
+// the most buffers an output sink holds that are not written yet
+#define OUT_SINK_DEPTH 4
+// the alignment of the memory of a buffer, one page
+#define OUT_BUF_ALIGN 4096
+
+/* How instructions are written.
+ *   - FORMAT_TEXT is the START / WRITE / SET_TEMPERATURE / END text
+ *   - FORMAT_BIN is the binary stream described in seqbot_bin.h
+ */
+enum output_format {
+    FORMAT_TEXT,
+    FORMAT_BIN
+};
+
+/* A growable buffer that output is built up in before it is written.
+ *   - len is the number of bytes of data in use
+ *   - capacity is the number of bytes allocated for data
+ *   - fixed is set when data is memory the caller owns, which is never
+ *     grown: running out of it is an error
+ */
+struct out_buf {
+    char *data;
+    size_t len;
+    size_t capacity;
+    int fixed;
+};
+
+void write_all(int fd, const char *data, size_t n);
+
+void init_out_buf(struct out_buf *buf);
+void free_out_buf(struct out_buf *buf);
+char *reserve_out_buf(struct out_buf *buf, size_t n);
+void append_out_buf(struct out_buf *buf, const char *data, size_t n);
+void append_int_out_buf(struct out_buf *buf, long value);
+void flush_out_buf(struct out_buf *buf, int fd);
+
+/* An output sink writes buffers to a file descriptor on a thread of its
+ * own, so that the next buffers can be filled while the last ones are being
+ * written. Up to OUT_SINK_DEPTH buffers can be queued, and the ones queued
+ * together are written with one writev().
+ */
+struct out_sink;
+
+struct out_sink *open_out_sink(int fd);
+// hand the contents of buf to the sink, leaving buf empty
+void submit_out_buf(struct out_sink *sink, struct out_buf *buf);
+// queue data to be written in place; it must stay unchanged until the ticket is waited for
+unsigned long submit_out_data(struct out_sink *sink, const char *data, size_t n);
+void wait_out_sink(struct out_sink *sink, unsigned long ticket);
+// write everything submitted to sink, then free it
+void close_out_sink(struct out_sink *sink);
+
+#endif
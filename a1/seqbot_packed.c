@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "seqbot_packed.h"
+#include "seqbot_melt.h"
+
+#define ALL_BASES 0xFFFFFFFFFFFFFFFFULL
+
+const signed char base_code[256] = {
+    [0 ... 255] = -1,
+    ['A'] = BASE_A, ['C'] = BASE_C, ['G'] = BASE_G, ['T'] = BASE_T
+};
+
+const char base_char[4] = {'A', 'C', 'G', 'T'};
+
+/* Return the number of words needed to hold length bases.
+ * At least one word is always allocated so words is never NULL.
+ */
+static int words_for(int length)
+{
+    int n = PACKED_WORDS(length);
+    return n > 0 ? n : 1;
+}
+
+/* Return the mask of the valid bits in the last word of seq.
+ */
+static uint64_t tail_mask(struct packed_seq *seq)
+{
+    int used = seq->length % BASES_PER_WORD;
+    if (used == 0){
+        return ALL_BASES;
+    }
+    return (1ULL << (2 * used)) - 1;
+}
+
+/* Return the codes of the 8 bases in chars, which are all valid, packed
+ * into 16 bits. Bits 1 and 2 of 'A', 'C', 'G' and 'T' are 0, 1, 3 and 2,
+ * so swapping the last two gives the code of each byte, and the 8 codes
+ * are then folded together two, four and eight at a time.
+ */
+static uint64_t pack_8_bases(uint64_t chars)
+{
+    uint64_t x = (chars >> 1) & 0x0303030303030303ULL;
+    x ^= (x >> 1) & 0x0101010101010101ULL;
+    x = (x | x >> 6) & 0x000F000F000F000FULL;
+    x = (x | x >> 12) & 0x000000FF000000FFULL;
+    return (x | x >> 24) & 0xFFFF;
+}
+
+/* Make sure seq has room for length bases.
+ */
+static void reserve_packed(struct packed_seq *seq, int length)
+{
+    int needed = words_for(length);
+    if (needed <= seq->capacity){
+        return;
+    }
+    seq->words = realloc(seq->words, needed * sizeof(uint64_t));
+    if (seq->words == NULL){
+        perror("realloc");
+        exit(1);
+    }
+    seq->capacity = needed;
+}
+
+/* Create a packed sequence of length bases, all set to 'A'.
+ * Return a pointer to the newly created packed_seq struct.
+ */
+struct packed_seq *create_packed_seq(int length)
+{
+    struct packed_seq *seq = malloc(sizeof(struct packed_seq));
+    if (seq == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    seq->capacity = words_for(length);
+    seq->words = calloc(seq->capacity, sizeof(uint64_t));
+    if (seq->words == NULL){
+        perror("calloc");
+        exit(1);
+    }
+    seq->length = length;
+    return seq;
+}
+
+/* Free all dynamically allocated memory pointed to by seq
+ */
+void free_packed_seq(struct packed_seq *seq)
+{
+    free(seq->words);
+    free(seq);
+}
+
+/* Pack the first sequence_length characters of sequence into seq, growing
+ * seq if needed. Return 0 on success or -1 if the sequence is empty or
+ * contains characters other than 'A', 'C', 'G', 'T', in which case seq
+ * is left as it was.
+ * The sequence is validated by the melting temperature kernel, and then
+ * packed 8 bases at a time where the bytes of a word are in base order.
+ */
+int encode_sequence(const char *sequence, int sequence_length,
+                    struct packed_seq *seq)
+{
+    uint64_t chars;
+    int i = 0;
+
+    if (fast_melting_temperature(sequence, sequence_length) < 0){
+        return -1;
+    }
+    reserve_packed(seq, sequence_length);
+    memset(seq->words, 0, PACKED_WORDS(sequence_length) * sizeof(uint64_t));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i + 8 <= sequence_length; i += 8){
+        memcpy(&chars, sequence + i, 8);
+        seq->words[i / BASES_PER_WORD] |= pack_8_bases(chars) << (2 * (i % BASES_PER_WORD));
+    }
+#endif
+    for (; i < sequence_length; i++){
+        seq->words[i / BASES_PER_WORD] |= (uint64_t)base_code[(unsigned char)sequence[i]]
+                                          << (2 * (i % BASES_PER_WORD));
+    }
+    seq->length = sequence_length;
+    return 0;
+}
+
+/* Write the bases of seq from index from up to but not including to into
+ * sequence as ASCII characters. sequence must have room for to - from
+ * characters; it is not null terminated.
+ */
+void decode_sequence(struct packed_seq *seq, int from, int to, char *sequence)
+{
+    uint64_t word = 0;
+
+    assert(from >= 0 && to <= seq->length);
+    if (from < to){
+        word = seq->words[from / BASES_PER_WORD] >> (2 * (from % BASES_PER_WORD));
+    }
+    for (int i = from; i < to; i++){
+        if (i % BASES_PER_WORD == 0){
+            word = seq->words[i / BASES_PER_WORD];
+        }
+        sequence[i - from] = base_char[word & 3];
+        word >>= 2;
+    }
+}
+
+/* Return the 2-bit code of the base at index
+ */
+int get_base(struct packed_seq *seq, int index)
+{
+    assert(index >= 0 && index < seq->length);
+    return (seq->words[index / BASES_PER_WORD] >> (2 * (index % BASES_PER_WORD))) & 3;
+}
+
+/* Set the base at index to the 2-bit code
+ */
+void set_base(struct packed_seq *seq, int index, int code)
+{
+    assert(index >= 0 && index < seq->length);
+    int shift = 2 * (index % BASES_PER_WORD);
+    uint64_t *word = &seq->words[index / BASES_PER_WORD];
+    *word = (*word & ~(3ULL << shift)) | ((uint64_t)code << shift);
+}
+
+/* Return the index of the first base where a and b, which have the same
+ * length, differ, or their length if they are equal. The lowest set bit
+ * of the XOR of two words is in the first base that differs.
+ */
+int first_difference(struct packed_seq *a, struct packed_seq *b)
+{
+    uint64_t diff;
+
+    assert(a->length == b->length);
+    for (int w = 0; w < PACKED_WORDS(a->length); w++){
+        diff = a->words[w] ^ b->words[w];
+        if (diff != 0){
+            return w * BASES_PER_WORD + __builtin_ctzll(diff) / 2;
+        }
+    }
+    return a->length;
+}
+
+/* Replace seq with its complement. A <-> T and C <-> G, which flips
+ * both bits of every code, so the whole word is complemented at once.
+ */
+void complement_packed(struct packed_seq *seq)
+{
+    int n = PACKED_WORDS(seq->length);
+
+    if (n == 0){
+        return;
+    }
+    for (int w = 0; w < n; w++){
+        seq->words[w] ^= ALL_BASES;
+    }
+    seq->words[n - 1] &= tail_mask(seq);
+}
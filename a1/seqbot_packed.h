@@ -0,0 +1,54 @@
+#ifndef SEQBOT_PACKED
+#define SEQBOT_PACKED
+
+#include <stdint.h>
+
+// number of bases stored in one word of a packed sequence
+#define BASES_PER_WORD 32
+
+// the number of words that hold length bases
+#define PACKED_WORDS(length) (((length) + BASES_PER_WORD - 1) / BASES_PER_WORD)
+
+// 2-bit codes for each base. A complement is the code XOR 3.
+#define BASE_A 0
+#define BASE_C 1
+#define BASE_G 2
+#define BASE_T 3
+
+/* A DNA sequence stored with 2 bits per base.
+ *   - length is the number of bases in the sequence
+ *   - capacity is the number of words allocated in words
+ *   - words holds the bases. Base i is stored in bits 2*(i%32) and
+ *     2*(i%32)+1 of words[i/32]. Bits past length are always 0, so two
+ *     sequences of the same length are equal if their words are.
+ * words may also be storage of the caller, such as an array on the stack,
+ * if capacity covers every sequence encoded into it.
+ */
+struct packed_seq {
+    int length;
+    int capacity;
+    uint64_t *words;
+};
+
+// maps an ASCII character to its 2-bit code, or -1 if it is not a base
+extern const signed char base_code[256];
+// maps a 2-bit code back to its ASCII character
+extern const char base_char[4];
+
+struct packed_seq *create_packed_seq(int length);
+void free_packed_seq(struct packed_seq *seq);
+
+// pack and validate a sequence; 0 if it is all bases, else -1
+int encode_sequence(const char *sequence, int sequence_length,
+                    struct packed_seq *seq);
+// write the bases from index from up to to of seq as ASCII characters
+void decode_sequence(struct packed_seq *seq, int from, int to, char *sequence);
+
+int get_base(struct packed_seq *seq, int index);
+void set_base(struct packed_seq *seq, int index, int code);
+// the index of the first base where a and b differ, or their length if none
+int first_difference(struct packed_seq *a, struct packed_seq *b);
+
+void complement_packed(struct packed_seq *seq);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "seqbot_helpers.h"
+#include "seqbot_reader.h"
+#include "seqbot_melt.h"
+#include "seqbot_output.h"
+
+/* The decimal text of a number that only ever goes up by one.
+ * Incrementing the text in place is cheaper than formatting the number
+ * again for every window.
+ */
+struct decimal_counter {
+    char digits[24];
+    int len;
+};
+
+static void increment_counter(struct decimal_counter *counter)
+{
+    int i = counter->len - 1;
+    while (i >= 0 && counter->digits[i] == '9'){
+        counter->digits[i--] = '0';
+    }
+    if (i >= 0){
+        counter->digits[i]++;
+        return;
+    }
+    memmove(counter->digits + 1, counter->digits, counter->len);
+    counter->digits[0] = '1';
+    counter->len++;
+}
+
+/* Append "<record> <start> <temperature>" for every window of sequence
+ * whose temperature is within the limits of opts, handing out to sink
+ * whenever OUT_SINK_SIZE bytes have built up.
+ * The temperature of a window is kept as a running sum of melt_weight:
+ * each step adds the base entering the window and subtracts the one
+ * leaving it. invalid counts the characters in the window that are not
+ * bases, which have a weight of 0; a window is skipped while it is not 0.
+ * The text of record, and the text of the start kept by a counter, are
+ * copied into each line rather than formatted again.
+ */
+static void profile_sequence(struct out_buf *out, struct out_sink *sink,
+                             long record, int window,
+                             const char *sequence, long length,
+                             struct profile_options *opts)
+{
+    struct decimal_counter prefix = {.len = 0};
+    struct decimal_counter start = {.digits = "0", .len = 1};
+    char digits[24];
+    long temperature = 0;
+    long value;
+    int invalid = 0;
+    int n;
+    int w;
+    char *p;
+
+    prefix.len = snprintf(prefix.digits, sizeof(prefix.digits), "%ld ", record);
+    for (long i = 0; i < length; i++){
+        w = melt_weight[(unsigned char)sequence[i]];
+        temperature += w;
+        invalid += w == 0;
+        if (i >= window){
+            w = melt_weight[(unsigned char)sequence[i - window]];
+            temperature -= w;
+            invalid -= w == 0;
+        }
+        if (i < window - 1){
+            continue;
+        }
+        increment_counter(&start);
+        if (invalid > 0 || temperature < opts->tm_min || temperature > opts->tm_max){
+            continue;
+        }
+        n = 0;
+        value = temperature;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        p = reserve_out_buf(out, prefix.len + start.len + n + 2);
+        memcpy(p, prefix.digits, prefix.len);
+        p += prefix.len;
+        memcpy(p, start.digits, start.len);
+        p += start.len;
+        *p++ = ' ';
+        out->len += prefix.len + start.len + n + 2;
+        while (n > 0){
+            *p++ = digits[--n];
+        }
+        *p = '\n';
+        if (out->len >= OUT_SINK_SIZE){
+            submit_out_buf(sink, out);
+        }
+    }
+}
+
+/* Print the melting temperature of every window of window bases in the
+ * sequences of filename, in one pass over each sequence.
+ * filename is read as generate_molecules_from_file reads it: records of
+ * "<length> <sequence> <mode>" lines, FASTA or FASTQ. Each window is
+ * printed as
+ *     <record> <start> <temperature>
+ * where record counts the records from 1 and start is the position of the
+ * first base of the window in the record, counting from 1. The temperature
+ * is the one calculate_melting_temperature gives the window.
+ * Only windows with a temperature from opts->tm_min to opts->tm_max are
+ * printed. Windows that contain a character other than 'A', 'C', 'G', 'T'
+ * are skipped, and so is any record shorter than window. The mode and
+ * length of a record are ignored.
+ * The program exits with an error if window is not positive or the file
+ * cannot be parsed.
+ */
+void print_melting_profile(int window, char *filename,
+                           struct profile_options *opts)
+{
+    struct genfile_input input;
+    struct genfile_scanner scanner;
+    struct genfile_record record;
+    struct out_buf out;
+    struct out_sink *sink;
+    long num_records = 0;
+    int status;
+
+    if (window <= 0){
+        fprintf(stderr, "profile: window must be at least 1\n");
+        exit(1);
+    }
+    open_genfile_input(filename, &input);
+    init_scanner(&scanner, &input, 0);
+    init_out_buf(&out);
+    fflush(stdout);
+    sink = open_out_sink(STDOUT_FILENO);
+    while ((status = next_record(&scanner, &record)) > 0){
+        profile_sequence(&out, sink, ++num_records, window, record.sequence,
+                         record.sequence_len, opts);
+        release_genfile_input(&input, scanner.pos);
+    }
+    submit_out_buf(sink, &out);
+    close_out_sink(sink);
+    free_out_buf(&out);
+    close_genfile_input(&input);
+    if (status < 0){
+        fprintf(stderr, "profile: %s: malformed record %ld\n", filename,
+                num_records + 1);
+        exit(1);
+    }
+}
@@ -0,0 +1,915 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "seqbot_reader.h"
+
+// size of each read() when the input cannot be mapped, or is compressed
+#define GENFILE_READ_SIZE (1 << 20)
+// an input that is not mapped is read or inflated into blocks of this size
+#define GENFILE_STREAM_BLOCK (1 << 20)
+// the room before the contents of a block, where the start of a record
+// from the block before it is copied so that the record is contiguous
+#define GENFILE_STREAM_HEADROOM (1 << 16)
+// the stream thread stops once this many blocks are in use, unless the
+// scanner is waiting for the rest of a record
+#define GENFILE_STREAM_BLOCKS 16
+
+/* A block of an input that arrives through a stream.
+ *   - data is the allocation of size bytes, and the contents of the block
+ *     are the len bytes at start
+ *   - a block of the ring has GENFILE_STREAM_HEADROOM bytes before its
+ *     contents and GENFILE_STREAM_BLOCK bytes for them; any other size is
+ *     a window the scanner allocated for a record longer than the headroom
+ */
+struct genfile_block {
+    char *data;
+    size_t size;
+    char *start;
+    size_t len;
+    struct genfile_block *next;
+};
+
+/* An input that cannot be mapped, such as a pipe, or that is gzip
+ * compressed, being read or inflated by its own thread.
+ * The thread fills a ring of blocks and queues each full block for the
+ * scanner, so the scanner parses the blocks before it while the next one
+ * is filled. The scanner parses one block at a time, its
+ * window, and carries the start of a record that does not end in the
+ * window over to the next one. The blocks the scanner has taken stay
+ * where they are until release_genfile_input hands them back, so records
+ * keep pointing into them.
+ *   - compressed is 1 if fd is inflated, and 0 if it is read as it is
+ *   - in holds bytes read from fd that have not been used, the avail_in
+ *     bytes at next_in of zs, and inflated is the result of the last call
+ *     to inflate
+ *   - ready is the queue of filled blocks the scanner has not taken
+ *   - held is the list of blocks the scanner has taken, oldest first,
+ *     ending with window
+ *   - spare is the list of ring blocks handed back, and num_blocks the
+ *     number of ring blocks allocated
+ *   - waiting is 1 while the scanner is waiting for a block
+ *   - done is 1 once the whole input has been filled in or inflating
+ *     failed, in which case error says why
+ *   - exhausted is 1 once the scanner has taken the last block
+ *   - cancelled is 1 once the input is being closed
+ */
+struct genfile_stream {
+    char *filename;
+    int fd;
+    int compressed;
+    z_stream zs;
+    int inflated;
+    unsigned char in[GENFILE_READ_SIZE];
+    struct genfile_block *ready;
+    struct genfile_block **ready_tail;
+    struct genfile_block *held;
+    struct genfile_block *window;
+    struct genfile_block *spare;
+    int num_blocks;
+    int waiting;
+    int done;
+    int exhausted;
+    int cancelled;
+    const char *error;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* Read up to n bytes from fd into buf, retrying after short reads.
+ * Return the number of bytes read, which is less than n only at the end.
+ */
+static size_t read_fully(int fd, void *buf, size_t n)
+{
+    size_t total = 0;
+    ssize_t got;
+
+    while (total < n){
+        got = read(fd, (char *)buf + total, n - total);
+        if (got < 0 && errno == EINTR){
+            continue;
+        }
+        if (got < 0){
+            perror("read");
+            exit(1);
+        }
+        if (got == 0){
+            break;
+        }
+        total += got;
+    }
+    return total;
+}
+
+/* Inflate the next size bytes of the stream into out, or fewer at the end
+ * of the input. A file of several gzip members one after another, as bgzip
+ * writes, is inflated as one. Return the number of bytes inflated, and set
+ * *error if the data is not valid gzip.
+ */
+static size_t inflate_block(struct genfile_stream *stream, char *out, size_t size,
+                            const char **error)
+{
+    stream->zs.next_out = (unsigned char *)out;
+    stream->zs.avail_out = size;
+    while (stream->zs.avail_out > 0){
+        if (stream->zs.avail_in == 0){
+            stream->zs.next_in = stream->in;
+            stream->zs.avail_in = read_fully(stream->fd, stream->in, GENFILE_READ_SIZE);
+            if (stream->zs.avail_in == 0){
+                if (stream->inflated != Z_STREAM_END){
+                    *error = "unexpected end of gzip data";
+                }
+                break;
+            }
+        }
+        if (stream->inflated == Z_STREAM_END){
+            inflateReset(&stream->zs);
+        }
+        stream->inflated = inflate(&stream->zs, Z_NO_FLUSH);
+        if (stream->inflated != Z_OK && stream->inflated != Z_STREAM_END
+            && stream->inflated != Z_BUF_ERROR){
+            *error = "invalid gzip data";
+            break;
+        }
+    }
+    return size - stream->zs.avail_out;
+}
+
+/* Read the next size bytes of the stream into out, or fewer at the end of
+ * the input, starting with the bytes already read into in.
+ */
+static size_t read_block(struct genfile_stream *stream, char *out, size_t size)
+{
+    size_t n = stream->zs.avail_in < size ? stream->zs.avail_in : size;
+
+    memcpy(out, stream->zs.next_in, n);
+    stream->zs.next_in += n;
+    stream->zs.avail_in -= n;
+    return n + read_fully(stream->fd, out + n, size - n);
+}
+
+/* Hand block back to stream: a ring block is kept for the thread to fill
+ * again, and a window the scanner allocated is freed. The lock is held.
+ */
+static void give_back_block(struct genfile_stream *stream,
+                            struct genfile_block *block)
+{
+    if (block->size != GENFILE_STREAM_HEADROOM + GENFILE_STREAM_BLOCK){
+        free(block->data);
+        free(block);
+        return;
+    }
+    block->next = stream->spare;
+    stream->spare = block;
+    pthread_cond_broadcast(&stream->cond);
+}
+
+/* Return a new block of size bytes whose contents start after headroom
+ * bytes and are empty.
+ */
+static struct genfile_block *create_block(size_t size, size_t headroom)
+{
+    struct genfile_block *block = malloc(sizeof(struct genfile_block));
+
+    if (block == NULL || (block->data = malloc(size)) == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    block->size = size;
+    block->start = block->data + headroom;
+    block->len = 0;
+    block->next = NULL;
+    return block;
+}
+
+/* Read or inflate the stream into blocks of the ring until the input ends,
+ * it is cancelled, or the data is not valid gzip. A block is reused once it has
+ * been handed back, and a new one is made while fewer than
+ * GENFILE_STREAM_BLOCKS exist, or whenever the scanner is waiting with no
+ * block queued, since the records in the blocks it holds may need more.
+ */
+static void *genfile_stream_main(void *arg)
+{
+    struct genfile_stream *stream = arg;
+    struct genfile_block *block;
+    const char *error = NULL;
+    size_t len;
+
+    while (1){
+        pthread_mutex_lock(&stream->lock);
+        while (!stream->cancelled && stream->spare == NULL
+               && stream->num_blocks >= GENFILE_STREAM_BLOCKS
+               && !(stream->waiting && stream->ready == NULL)){
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (stream->cancelled){
+            pthread_mutex_unlock(&stream->lock);
+            break;
+        }
+        block = stream->spare;
+        if (block != NULL){
+            stream->spare = block->next;
+        }
+        else {
+            stream->num_blocks++;
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        if (block == NULL){
+            block = create_block(GENFILE_STREAM_HEADROOM + GENFILE_STREAM_BLOCK,
+                                 GENFILE_STREAM_HEADROOM);
+        }
+        block->start = block->data + GENFILE_STREAM_HEADROOM;
+        if (stream->compressed){
+            len = inflate_block(stream, block->start, GENFILE_STREAM_BLOCK, &error);
+        }
+        else {
+            len = read_block(stream, block->start, GENFILE_STREAM_BLOCK);
+        }
+        block->len = len;
+        block->next = NULL;
+
+        pthread_mutex_lock(&stream->lock);
+        if (len > 0){
+            *stream->ready_tail = block;
+            stream->ready_tail = &block->next;
+        }
+        else {
+            give_back_block(stream, block);
+        }
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+        if (len < GENFILE_STREAM_BLOCK){
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->done = 1;
+    stream->error = error;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/* Start a thread reading the contents of fd into stream blocks, inflating
+ * them if compressed is 1. The first prefix_len bytes of fd have already
+ * been read into prefix.
+ */
+static void open_genfile_stream(char *filename, int fd, int compressed,
+                                struct genfile_input *input,
+                                const char *prefix, size_t prefix_len)
+{
+    struct genfile_stream *stream = malloc(sizeof(struct genfile_stream));
+
+    if (stream == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    input->stream = stream;
+
+    stream->filename = filename;
+    stream->fd = fd;
+    stream->compressed = compressed;
+    memset(&stream->zs, 0, sizeof(stream->zs));
+    if (compressed && inflateInit2(&stream->zs, 15 + 16) != Z_OK){
+        fprintf(stderr, "%s: could not start inflating\n", filename);
+        exit(1);
+    }
+    stream->inflated = Z_OK;
+    memcpy(stream->in, prefix, prefix_len);
+    stream->zs.next_in = stream->in;
+    stream->zs.avail_in = prefix_len;
+    stream->ready = NULL;
+    stream->ready_tail = &stream->ready;
+    stream->held = NULL;
+    stream->window = NULL;
+    stream->spare = NULL;
+    stream->num_blocks = 0;
+    stream->waiting = 0;
+    stream->done = 0;
+    stream->exhausted = 0;
+    stream->cancelled = 0;
+    stream->error = NULL;
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    if (pthread_create(&stream->thread, NULL, genfile_stream_main, stream) != 0){
+        perror("pthread_create");
+        exit(1);
+    }
+}
+
+/* Wait for the next block of the stream and take it off the queue, or
+ * return NULL once every block has been taken. Exit the program as soon as
+ * the input turns out not to be valid gzip data, since the blocks before
+ * the error may hold garbage.
+ */
+static struct genfile_block *take_block(struct genfile_stream *stream)
+{
+    struct genfile_block *block;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->waiting = 1;
+    pthread_cond_broadcast(&stream->cond);
+    while (stream->ready == NULL && !stream->done){
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    stream->waiting = 0;
+    block = stream->ready;
+    if (stream->done && stream->error != NULL){
+        fprintf(stderr, "%s: %s\n", stream->filename, stream->error);
+        exit(1);
+    }
+    if (block != NULL){
+        stream->ready = block->next;
+        if (stream->ready == NULL){
+            stream->ready_tail = &stream->ready;
+        }
+        block->next = NULL;
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return block;
+}
+
+/* Return the end of the window of stream.
+ */
+static char *window_end(struct genfile_stream *stream)
+{
+    return stream->window->start + stream->window->len;
+}
+
+/* Move scanner on to the next block of its stream, carrying over the
+ * bytes of the window from the cursor on, which start a record that ends
+ * in a later block. They are copied into the headroom of the next block,
+ * or if there are too many, the window is extended: in place when it is
+ * one the scanner allocated and has room, or else into a new window twice
+ * the size needed, so a long record is copied a bounded number of times.
+ * The end of the scanner is left at the cursor, with everything after it
+ * still to be searched. Return 0 if every block has been taken, and
+ * otherwise 1.
+ */
+static int next_window(struct genfile_scanner *scanner)
+{
+    struct genfile_stream *stream = scanner->input->stream;
+    struct genfile_block *window = stream->window;
+    struct genfile_block *block = take_block(stream);
+    struct genfile_block *next;
+    size_t carry = window != NULL ? window_end(stream) - scanner->pos : 0;
+
+    if (block == NULL){
+        stream->exhausted = 1;
+        return 0;
+    }
+    pthread_mutex_lock(&stream->lock);
+    if (window != NULL && window->size != GENFILE_STREAM_HEADROOM + GENFILE_STREAM_BLOCK
+        && window->data + window->size - window_end(stream) >= block->len){
+        scanner->searched = window_end(stream);
+        memcpy(window_end(stream), block->start, block->len);
+        window->len += block->len;
+        give_back_block(stream, block);
+        pthread_mutex_unlock(&stream->lock);
+        return 1;
+    }
+    if (carry <= GENFILE_STREAM_HEADROOM){
+        next = block;
+        next->start -= carry;
+        next->len += carry;
+        memcpy(next->start, scanner->pos, carry);
+    }
+    else {
+        next = create_block(2 * (carry + block->len), 0);
+        memcpy(next->start, scanner->pos, carry);
+        memcpy(next->start + carry, block->start, block->len);
+        next->len = carry + block->len;
+        give_back_block(stream, block);
+    }
+    if (window != NULL){
+        window->next = next;
+    }
+    else {
+        stream->held = next;
+    }
+    stream->window = next;
+    pthread_mutex_unlock(&stream->lock);
+    scanner->pos = next->start;
+    scanner->end = next->start;
+    scanner->searched = next->start;
+    return 1;
+}
+
+/* Map filename into memory, or if it cannot be mapped, read it into
+ * blocks by a thread of its own while it is scanned. A file that starts
+ * with the gzip magic bytes is inflated into blocks the same way.
+ * Exit the program if the file cannot be opened.
+ */
+void open_genfile_input(char *filename, struct genfile_input *input)
+{
+    struct stat st;
+    unsigned char magic[2];
+    size_t magic_len;
+    int regular;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0){
+        perror(filename);
+        exit(1);
+    }
+    input->data = NULL;
+    input->size = 0;
+    input->mapped = 0;
+    input->released = 0;
+    input->stream = NULL;
+    regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    // a regular file is read again from the start, so only peek at it
+    magic_len = read_fully(fd, magic, sizeof(magic));
+    if (magic_len == 2 && magic[0] == 0x1f && magic[1] == 0x8b){
+        open_genfile_stream(filename, fd, 1, input, (char *)magic, magic_len);
+        return;
+    }
+    if (regular){
+        if (st.st_size == 0){
+            close(fd);
+            return;
+        }
+        input->data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (input->data != MAP_FAILED){
+            input->size = st.st_size;
+            input->mapped = 1;
+            madvise(input->data, input->size, MADV_SEQUENTIAL);
+            close(fd);
+            return;
+        }
+    }
+    if (regular){
+        lseek(fd, 0, SEEK_SET);
+        magic_len = 0;
+    }
+    open_genfile_stream(filename, fd, 0, input, (char *)magic, magic_len);
+}
+
+/* Hand the blocks of a stream that come before the one holding upto back
+ * to the stream, which may be waiting for one to fill. The window of the
+ * scanner is never handed back.
+ */
+static void release_stream_blocks(struct genfile_stream *stream, const char *upto)
+{
+    struct genfile_block *block;
+
+    pthread_mutex_lock(&stream->lock);
+    while (stream->held != stream->window
+           && !(upto >= stream->held->start
+                && upto <= stream->held->start + stream->held->len)){
+        block = stream->held;
+        stream->held = block->next;
+        give_back_block(stream, block);
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/* Give back the pages of a mapped input that lie wholly before upto, once
+ * at least GENFILE_RELEASE_SIZE bytes can go, or the blocks of a streamed
+ * input before the one holding upto. Everything before upto has been
+ * written, so it is never read again. Without this a large input would
+ * stay resident, along with every page changed in place.
+ */
+void release_genfile_input(struct genfile_input *input, const char *upto)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t offset;
+
+    if (input->stream != NULL){
+        release_stream_blocks(input->stream, upto);
+        return;
+    }
+    offset = (upto - input->data) / page * page;
+    if (!input->mapped || offset < input->released + GENFILE_RELEASE_SIZE){
+        return;
+    }
+    madvise(input->data + input->released, offset - input->released, MADV_DONTNEED);
+    input->released = offset;
+}
+
+/* Free a list of stream blocks.
+ */
+static void free_blocks(struct genfile_block *block)
+{
+    struct genfile_block *next;
+
+    while (block != NULL){
+        next = block->next;
+        free(block->data);
+        free(block);
+        block = next;
+    }
+}
+
+void close_genfile_input(struct genfile_input *input)
+{
+    struct genfile_stream *stream = input->stream;
+
+    if (stream != NULL){
+        pthread_mutex_lock(&stream->lock);
+        stream->cancelled = 1;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(stream->thread, NULL);
+        free_blocks(stream->ready);
+        free_blocks(stream->held);
+        free_blocks(stream->spare);
+        if (stream->compressed){
+            inflateEnd(&stream->zs);
+        }
+        close(stream->fd);
+        pthread_cond_destroy(&stream->cond);
+        pthread_mutex_destroy(&stream->lock);
+        free(stream);
+    }
+    if (input->mapped){
+        munmap(input->data, input->size);
+    }
+}
+
+/* Skip blanks on the current line of scanner.
+ */
+static void skip_blanks(struct genfile_scanner *scanner)
+{
+    while (scanner->pos < scanner->end && is_blank(*scanner->pos)){
+        scanner->pos++;
+    }
+}
+
+/* Parse an optionally signed decimal number at the cursor of scanner.
+ * Values too large for an int are clamped to just past INT_MAX so that they
+ * fail the range checks. Return 0 on success or -1 if there are no digits.
+ */
+static int scan_number(struct genfile_scanner *scanner, long *value)
+{
+    char *p = scanner->pos;
+    int negative = 0;
+    long n = 0;
+
+    if (p < scanner->end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+    if (p == scanner->end || *p < '0' || *p > '9'){
+        return -1;
+    }
+    while (p < scanner->end && *p >= '0' && *p <= '9'){
+        if (n <= INT_MAX){
+            n = n * 10 + (*p - '0');
+        }
+        p++;
+    }
+    scanner->pos = p;
+    *value = negative ? -n : n;
+    return 0;
+}
+
+/* Skip blank lines at the cursor of scanner, and the blanks at the start of
+ * the next line. Return 0 if the input ends first, otherwise 1.
+ */
+static int skip_blank_lines(struct genfile_scanner *scanner)
+{
+    while (1){
+        skip_blanks(scanner);
+        if (scanner->pos == scanner->end){
+            return 0;
+        }
+        if (*scanner->pos != '\n'){
+            return 1;
+        }
+        scanner->pos++;
+    }
+}
+
+/* Move the cursor of scanner past the end of the current line.
+ */
+static void skip_line(struct genfile_scanner *scanner)
+{
+    char *newline = memchr(scanner->pos, '\n', scanner->end - scanner->pos);
+    scanner->pos = newline != NULL ? newline + 1 : scanner->end;
+}
+
+/* Parse the next "<length> <sequence> <mode>" line of scanner into record,
+ * skipping blank lines. Anything after the mode on a line is ignored.
+ * Return 1 if a record was read, 0 at the end of the input, or -1 if the
+ * next line is not a "<length> <sequence> <mode>" record.
+ */
+static int next_line_record(struct genfile_scanner *scanner,
+                            struct genfile_record *record)
+{
+    char *start;
+
+    if (!skip_blank_lines(scanner)){
+        return 0;
+    }
+    if (scan_number(scanner, &record->length) != 0){
+        return -1;
+    }
+    skip_blanks(scanner);
+    start = scanner->pos;
+    while (scanner->pos < scanner->end && *scanner->pos != '\n'
+           && !is_blank(*scanner->pos)){
+        scanner->pos++;
+    }
+    record->sequence = start;
+    record->sequence_len = scanner->pos - start;
+    skip_blanks(scanner);
+    if (scan_number(scanner, &record->mode) != 0){
+        return -1;
+    }
+    skip_line(scanner);
+    return 1;
+}
+
+/* Join the sequence lines at the cursor of scanner into one run of bases,
+ * reading lines until the end of the input or a line that starts with stop.
+ * Each line is moved down over the line breaks before it, so the bases end
+ * up contiguous in the input without being copied elsewhere. Blanks at the
+ * end of a line (such as '\r') are dropped. The joined bases become the
+ * sequence of record, and their number its length.
+ */
+static void join_sequence_lines(struct genfile_scanner *scanner, char stop,
+                                struct genfile_record *record)
+{
+    char *start = scanner->pos;
+    char *dest = start;
+    char *line;
+    long n;
+
+    while (scanner->pos < scanner->end && *scanner->pos != stop){
+        line = scanner->pos;
+        skip_line(scanner);
+        n = scanner->pos - line;
+        while (n > 0 && (line[n - 1] == '\n' || is_blank(line[n - 1]))){
+            n--;
+        }
+        if (dest != line){
+            memmove(dest, line, n);
+        }
+        dest += n;
+    }
+    record->sequence = start;
+    record->sequence_len = dest - start;
+    record->length = record->sequence_len;
+    record->mode = scanner->default_mode;
+}
+
+/* Parse the next FASTA record of scanner into record: a '>' header line
+ * followed by any number of sequence lines.
+ * Return 1 if a record was read, 0 at the end of the input, or -1 if the
+ * next line is not a header.
+ */
+static int next_fasta_record(struct genfile_scanner *scanner,
+                             struct genfile_record *record)
+{
+    if (!skip_blank_lines(scanner)){
+        return 0;
+    }
+    if (*scanner->pos != '>'){
+        return -1;
+    }
+    skip_line(scanner);
+    join_sequence_lines(scanner, '>', record);
+    return 1;
+}
+
+/* Return the number of bases join_sequence_lines would find at the cursor
+ * of scanner, without moving anything, and set *lines_end to where the
+ * sequence lines end.
+ */
+static long count_sequence_lines(struct genfile_scanner *scanner, char stop,
+                                 char **lines_end)
+{
+    char *p = scanner->pos;
+    char *line;
+    char *newline;
+    long bases = 0;
+    long n;
+
+    while (p < scanner->end && *p != stop){
+        line = p;
+        newline = memchr(p, '\n', scanner->end - p);
+        p = newline != NULL ? newline + 1 : scanner->end;
+        n = p - line;
+        while (n > 0 && (line[n - 1] == '\n' || is_blank(line[n - 1]))){
+            n--;
+        }
+        bases += n;
+    }
+    *lines_end = p;
+    return bases;
+}
+
+/* Parse the next FASTQ record of scanner into record: an '@' header line,
+ * sequence lines, a '+' line, then quality lines with one character per
+ * base. A quality line may start with '@' or '+', so the quality is
+ * skipped by counting characters rather than by looking for the next header.
+ * The whole record is checked before its sequence lines are joined, so an
+ * incomplete record leaves the input as it was.
+ * Return 1 if a record was read, 0 at the end of the input, or -1 if the
+ * record is incomplete.
+ */
+static int next_fastq_record(struct genfile_scanner *scanner,
+                             struct genfile_record *record)
+{
+    long quality = 0;
+    long bases;
+    char *p;
+
+    if (!skip_blank_lines(scanner)){
+        return 0;
+    }
+    if (*scanner->pos != '@'){
+        return -1;
+    }
+    skip_line(scanner);
+    bases = count_sequence_lines(scanner, '+', &p);
+    if (p == scanner->end){
+        return -1;
+    }
+    p = memchr(p, '\n', scanner->end - p);
+    p = p != NULL ? p + 1 : scanner->end;
+    while (quality < bases && p < scanner->end){
+        if (*p != '\n' && *p != '\r'){
+            quality++;
+        }
+        p++;
+    }
+    if (quality < bases){
+        return -1;
+    }
+    join_sequence_lines(scanner, '+', record);
+    scanner->pos = p;
+    skip_line(scanner);
+    return 1;
+}
+
+/* Parse the next record of scanner into record, in the format of the input.
+ * Return 1 if a record was read, 0 at the end of the input, or -1 if the
+ * input is not well formed at this point.
+ */
+static int scan_record(struct genfile_scanner *scanner,
+                       struct genfile_record *record)
+{
+    if (scanner->kind == INPUT_FASTA){
+        return next_fasta_record(scanner, record);
+    }
+    if (scanner->kind == INPUT_FASTQ){
+        return next_fastq_record(scanner, record);
+    }
+    return next_line_record(scanner, record);
+}
+
+/* Move the end of scanner to the end of the last record in its window
+ * that is known to be complete, searching back from filled to the data
+ * searched before. A line record ends at a newline, and so does a FASTQ
+ * record, which next_fastq_record checks is whole before it changes
+ * anything. A FASTA record only ends where the next header starts.
+ */
+static void find_complete_end(struct genfile_scanner *scanner, char *filled)
+{
+    char *from = scanner->searched > scanner->pos ? scanner->searched : scanner->pos;
+    char *p = filled;
+
+    while (p > from){
+        p--;
+        if (scanner->kind != INPUT_FASTA && *p == '\n'){
+            scanner->end = p + 1;
+            break;
+        }
+        if (scanner->kind == INPUT_FASTA && *p == '>' && p > scanner->pos
+            && p[-1] == '\n'){
+            scanner->end = p;
+            break;
+        }
+    }
+    if (scanner->end < scanner->pos){
+        scanner->end = scanner->pos;
+    }
+    scanner->searched = filled;
+}
+
+/* Move scanner on to the next block of a streamed input, and find the
+ * complete records in its window, or all of the window once the last
+ * block has been taken. Return 0 if there was no block left.
+ */
+static int advance_scanner(struct genfile_scanner *scanner)
+{
+    struct genfile_stream *stream = scanner->input->stream;
+
+    if (!next_window(scanner)){
+        if (stream->window != NULL){
+            scanner->end = window_end(stream);
+        }
+        return 0;
+    }
+    find_complete_end(scanner, window_end(stream));
+    return 1;
+}
+
+/* Parse the next record of scanner into record, in the format of the input.
+ * A streamed input is scanned a window at a time, only as far as its
+ * complete records, and once they run out the rest of the window is
+ * carried over to the next block. A FASTQ record that is incomplete may
+ * only be cut short, so it is tried again with more input too.
+ * Return 1 if a record was read, 0 at the end of the input, or -1 if the
+ * input is not well formed at this point.
+ */
+int next_record(struct genfile_scanner *scanner,
+                struct genfile_record *record)
+{
+    struct genfile_stream *stream = scanner->input->stream;
+    char *start;
+    int status;
+
+    if (stream == NULL){
+        return scan_record(scanner, record);
+    }
+    while (1){
+        start = scanner->pos;
+        status = scan_record(scanner, record);
+        if (stream->exhausted || status > 0 || (status < 0 && scanner->kind != INPUT_FASTQ)){
+            return status;
+        }
+        scanner->pos = start;
+        advance_scanner(scanner);
+    }
+}
+
+/* Start scanner at the beginning of input. The kind of input is taken from
+ * its first character that is not white space: '>' for FASTA, '@' for FASTQ,
+ * and anything else for "<length> <sequence> <mode>" lines. A streamed
+ * input is started at its first block that is not all white space.
+ */
+void init_scanner(struct genfile_scanner *scanner,
+                  struct genfile_input *input, int default_mode)
+{
+    char *p = input->data;
+    char *end = input->data + input->size;
+
+    scanner->input = input;
+    scanner->pos = input->data;
+    scanner->end = end;
+    scanner->searched = input->data;
+    scanner->kind = INPUT_RECORDS;
+    scanner->default_mode = default_mode;
+    if (input->stream != NULL){
+        p = NULL;
+        end = NULL;
+        while (p == end && next_window(scanner)){
+            p = scanner->pos;
+            end = window_end(input->stream);
+            while (p < end && (*p == '\n' || is_blank(*p))){
+                p++;
+            }
+            scanner->pos = p;
+        }
+    }
+    while (p < end && (*p == '\n' || is_blank(*p))){
+        p++;
+    }
+    if (p < end && *p == '>'){
+        scanner->kind = INPUT_FASTA;
+    }
+    else if (p < end && *p == '@'){
+        scanner->kind = INPUT_FASTQ;
+    }
+    if (input->stream != NULL){
+        scanner->end = scanner->pos;
+        scanner->searched = scanner->pos;
+        if (input->stream->exhausted){
+            scanner->end = end;
+        }
+        else {
+            find_complete_end(scanner, end);
+        }
+    }
+}
+
+/* Parse the one "<length> <sequence> <mode>" line from line to end into
+ * record, as next_record parses a line of such a file. The sequence of
+ * record points into the line. Return 0, or -1 if the line is not a record.
+ */
+int parse_line_record(char *line, char *end, struct genfile_record *record)
+{
+    struct genfile_scanner scanner = {.input = NULL, .pos = line, .end = end,
+                                      .searched = line, .kind = INPUT_RECORDS,
+                                      .default_mode = 0};
+
+    return next_line_record(&scanner, record) == 1 ? 0 : -1;
+}
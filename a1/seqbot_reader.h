@@ -0,0 +1,85 @@
+#ifndef SEQBOT_READER
+#define SEQBOT_READER
+
+#include <stddef.h>
+
+// pages of a mapped input are given back in steps of at least this many bytes
+#define GENFILE_RELEASE_SIZE (1 << 22)
+
+struct genfile_stream;
+
+/* The contents of a genfile input.
+ *   - data holds size bytes mapped from the file. The mapping is private
+ *     and writable, so sequences can be transformed in place without
+ *     touching the file.
+ *   - mapped is 1 if data must be released with munmap
+ *   - released is the length of the start of a mapping whose pages have
+ *     already been given back with release_genfile_input
+ *   - stream is set when the file cannot be mapped (a pipe, for example)
+ *     or is gzip compressed. data is then NULL, and a thread reads or
+ *     inflates the file into a bounded ring of blocks while it is being
+ *     scanned; release_genfile_input hands blocks back to it.
+ */
+struct genfile_input {
+    char *data;
+    size_t size;
+    int mapped;
+    size_t released;
+    struct genfile_stream *stream;
+};
+
+/* The formats genfile reads.
+ *   - INPUT_RECORDS is one "<length> <sequence> <mode>" record per line
+ *   - INPUT_FASTA and INPUT_FASTQ are FASTA and FASTQ files, where a
+ *     sequence may be wrapped over several lines
+ */
+enum genfile_kind {
+    INPUT_RECORDS,
+    INPUT_FASTA,
+    INPUT_FASTQ
+};
+
+/* A cursor over the records of a genfile input.
+ *   - default_mode is the mode given to FASTA and FASTQ records, which
+ *     have no mode of their own
+ *   - end is the end of the input, or for a streamed input, the end of
+ *     the last record in the current block known to be complete
+ *   - searched is how much of the current block of a streamed input has
+ *     been searched for the ends of complete records
+ */
+struct genfile_scanner {
+    struct genfile_input *input;
+    char *pos;
+    char *end;
+    char *searched;
+    enum genfile_kind kind;
+    int default_mode;
+};
+
+/* One "<length> <sequence> <mode>" record, or one FASTA or FASTQ record
+ * whose length is the number of bases it has.
+ *   - sequence points into the input and is not null terminated; it is
+ *     transformed by mode in place when the record is rendered
+ *   - sequence_len is the number of characters found in the sequence field
+ */
+struct genfile_record {
+    long length;
+    char *sequence;
+    long sequence_len;
+    long mode;
+};
+
+void open_genfile_input(char *filename, struct genfile_input *input);
+void release_genfile_input(struct genfile_input *input, const char *upto);
+void close_genfile_input(struct genfile_input *input);
+
+// start scanner at the first record of input
+void init_scanner(struct genfile_scanner *scanner,
+                  struct genfile_input *input, int default_mode);
+// parse the next record; 1 if read, 0 at the end, -1 if malformed
+int next_record(struct genfile_scanner *scanner,
+                struct genfile_record *record);
+// parse one "<length> <sequence> <mode>" line; 0 if it is a record, else -1
+int parse_line_record(char *line, char *end, struct genfile_record *record);
+
+#endif
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include "seqbot_render.h"
+#include "seqbot_bin.h"
+
+#ifdef SEQBOT_X86
+#include <immintrin.h>
+#endif
+
+// 1 for A/T, 2 for C/G and 0 for invalid characters
+static const unsigned char base_class[256] = {
+    ['A'] = 1, ['T'] = 1, ['C'] = 2, ['G'] = 2
+};
+
+// the 2-bit code of each base, used by the binary format
+static const unsigned char base_bits[256] = {
+    ['A'] = 0, ['C'] = 1, ['G'] = 2, ['T'] = 3
+};
+
+/* Append START in format to out.
+ */
+static void emit_start(struct out_buf *out, enum output_format format)
+{
+    if (format == FORMAT_BIN){
+        char start = BIN_START;
+        append_out_buf(out, &start, 1);
+        return;
+    }
+    append_out_buf(out, "START\n", 6);
+}
+
+/* Append the WRITE of run copies of base in format to out. In text the
+ * digits of run are written straight into the buffer from the end.
+ */
+static void emit_write(struct out_buf *out, char base, int run,
+                       enum output_format format)
+{
+    char *p;
+    int digits = 1;
+
+    if (format == FORMAT_BIN){
+        append_bin_write(out, base_bits[(unsigned char)base], run);
+        return;
+    }
+    p = reserve_out_buf(out, 8 + 10 + 1);
+
+    for (int r = run; r >= 10; r /= 10){
+        digits++;
+    }
+    p[0] = 'W'; p[1] = 'R'; p[2] = 'I'; p[3] = 'T'; p[4] = 'E'; p[5] = ' ';
+    p[6] = base; p[7] = ' ';
+    for (int d = digits - 1; d >= 0; d--){
+        p[8 + d] = '0' + run % 10;
+        run /= 10;
+    }
+    p[8 + digits] = '\n';
+    out->len += 8 + digits + 1;
+}
+
+/* Append the last run and the temperature lines to out and return the
+ * melting temperature.
+ */
+static int finish_render(struct out_buf *out, const char *sequence,
+                         int sequence_length, int run_start, int gc,
+                         enum output_format format)
+{
+    int temperature = 2 * sequence_length + 2 * gc;
+    emit_write(out, sequence[run_start], sequence_length - run_start, format);
+    if (format == FORMAT_BIN){
+        char end = BIN_END;
+        append_bin_temperature(out, temperature);
+        append_out_buf(out, &end, 1);
+        return temperature;
+    }
+    append_out_buf(out, "SET_TEMPERATURE ", 16);
+    append_int_out_buf(out, temperature);
+    append_out_buf(out, "\nEND\n", 5);
+    return temperature;
+}
+
+/* Render bases from index i to the end one at a time, continuing the run
+ * that starts at *run_start and adding to *gc.
+ * Return 0, or -1 if an invalid character is found.
+ */
+static int render_bases(struct out_buf *out, const char *sequence,
+                        int sequence_length, int i, int *run_start, int *gc,
+                        enum output_format format)
+{
+    int c;
+    for (; i < sequence_length; i++){
+        c = base_class[(unsigned char)sequence[i]];
+        if (c == 0){
+            return -1;
+        }
+        *gc += c - 1;
+        if (i > 0 && sequence[i] != sequence[i - 1]){
+            emit_write(out, sequence[*run_start], i - *run_start, format);
+            *run_start = i;
+        }
+    }
+    return 0;
+}
+
+/* Scalar kernel: one table lookup and one compare per base.
+ */
+int render_scalar(struct out_buf *out, const char *sequence,
+                  int sequence_length, enum output_format format)
+{
+    size_t start = out->len;
+    int run_start = 0;
+    int gc = 0;
+
+    if (sequence_length <= 0){
+        return -1;
+    }
+    emit_start(out, format);
+    if (render_bases(out, sequence, sequence_length, 0, &run_start, &gc, format) != 0){
+        out->len = start;
+        return -1;
+    }
+    return finish_render(out, sequence, sequence_length, run_start, gc, format);
+}
+
+#ifdef SEQBOT_X86
+
+/* SSE2 kernel: 16 bases at a time.
+ * Each block is compared with itself shifted back by one base; the set bits
+ * of the not-equal mask are exactly the positions where a new run starts.
+ * Validation and the G/C count come from the same compares as melt_sse2.
+ */
+__attribute__((target("sse2")))
+int render_sse2(struct out_buf *out, const char *sequence,
+                int sequence_length, enum output_format format)
+{
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i t = _mm_set1_epi8('T');
+    size_t start = out->len;
+    int run_start = 0;
+    int gc = 0;
+    int i;
+    unsigned bounds;
+
+    if (sequence_length <= 0){
+        return -1;
+    }
+    emit_start(out, format);
+    if (render_bases(out, sequence, 1, 0, &run_start, &gc, format) != 0){
+        out->len = start;
+        return -1;
+    }
+    for (i = 1; i + 16 <= sequence_length; i += 16){
+        __m128i v = _mm_loadu_si128((const __m128i *)(sequence + i));
+        __m128i prev = _mm_loadu_si128((const __m128i *)(sequence + i - 1));
+        __m128i is_gc = _mm_or_si128(_mm_cmpeq_epi8(v, c), _mm_cmpeq_epi8(v, g));
+        __m128i is_at = _mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, t));
+        if (_mm_movemask_epi8(_mm_or_si128(is_gc, is_at)) != 0xFFFF){
+            out->len = start;
+            return -1;
+        }
+        gc += __builtin_popcount(_mm_movemask_epi8(is_gc));
+        bounds = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, prev)) & 0xFFFF;
+        while (bounds != 0){
+            int pos = i + __builtin_ctz(bounds);
+            emit_write(out, sequence[run_start], pos - run_start, format);
+            run_start = pos;
+            bounds &= bounds - 1;
+        }
+    }
+    if (render_bases(out, sequence, sequence_length, i, &run_start, &gc, format) != 0){
+        out->len = start;
+        return -1;
+    }
+    return finish_render(out, sequence, sequence_length, run_start, gc, format);
+}
+
+/* AVX2 kernel: the same as render_sse2 but 32 bases at a time.
+ */
+__attribute__((target("avx2")))
+int render_avx2(struct out_buf *out, const char *sequence,
+                int sequence_length, enum output_format format)
+{
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i c = _mm256_set1_epi8('C');
+    const __m256i g = _mm256_set1_epi8('G');
+    const __m256i t = _mm256_set1_epi8('T');
+    size_t start = out->len;
+    int run_start = 0;
+    int gc = 0;
+    int i;
+    unsigned bounds;
+
+    if (sequence_length <= 0){
+        return -1;
+    }
+    emit_start(out, format);
+    if (render_bases(out, sequence, 1, 0, &run_start, &gc, format) != 0){
+        out->len = start;
+        return -1;
+    }
+    for (i = 1; i + 32 <= sequence_length; i += 32){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(sequence + i));
+        __m256i prev = _mm256_loadu_si256((const __m256i *)(sequence + i - 1));
+        __m256i is_gc = _mm256_or_si256(_mm256_cmpeq_epi8(v, c), _mm256_cmpeq_epi8(v, g));
+        __m256i is_at = _mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, t));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_or_si256(is_gc, is_at)) != 0xFFFFFFFFu){
+            out->len = start;
+            return -1;
+        }
+        gc += __builtin_popcount((unsigned)_mm256_movemask_epi8(is_gc));
+        bounds = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, prev));
+        while (bounds != 0){
+            int pos = i + __builtin_ctz(bounds);
+            emit_write(out, sequence[run_start], pos - run_start, format);
+            run_start = pos;
+            bounds &= bounds - 1;
+        }
+    }
+    if (render_bases(out, sequence, sequence_length, i, &run_start, &gc, format) != 0){
+        out->len = start;
+        return -1;
+    }
+    return finish_render(out, sequence, sequence_length, run_start, gc, format);
+}
+
+#endif
+
+/* Pick the kernel on the first call and replace the pointer, as
+ * fast_melting_temperature does.
+ */
+static int render_resolve(struct out_buf *out, const char *sequence,
+                          int sequence_length, enum output_format format);
+static render_fn render_kernel = render_resolve;
+
+static int render_resolve(struct out_buf *out, const char *sequence,
+                          int sequence_length, enum output_format format)
+{
+    render_fn chosen = render_scalar;
+#ifdef SEQBOT_X86
+    if (cpu_has_avx2()){
+        chosen = render_avx2;
+    }
+    else if (cpu_has_sse2()){
+        chosen = render_sse2;
+    }
+#endif
+    __atomic_store_n(&render_kernel, chosen, __ATOMIC_RELAXED);
+    return chosen(out, sequence, sequence_length, format);
+}
+
+int render_instructions(struct out_buf *out, const char *sequence,
+                        int sequence_length, enum output_format format)
+{
+    return __atomic_load_n(&render_kernel, __ATOMIC_RELAXED)(out, sequence,
+                                                             sequence_length, format);
+}
+
+/* Append to out the instructions print_instructions has always printed for
+ * an invalid sequence, whose sequence_length is -1 if it is too long to
+ * render. In text that is START, a WRITE for each run that a different
+ * valid base ends before the first invalid character after the first
+ * base, and INVALID SEQUENCE.
+ * The first base is not checked, so when it is the only invalid one its
+ * run is written like the others, followed by SET_TEMPERATURE -1 and END.
+ * In binary it is BIN_START followed by BIN_INVALID.
+ */
+void render_invalid(struct out_buf *out, const char *sequence,
+                    int sequence_length, enum output_format format)
+{
+    static const char bin_invalid[] = {BIN_START, BIN_INVALID};
+    int run_start = 0;
+    int i;
+
+    if (format == FORMAT_BIN){
+        append_out_buf(out, bin_invalid, sizeof(bin_invalid));
+        return;
+    }
+    emit_start(out, format);
+    if (sequence_length <= 0){
+        append_out_buf(out, "INVALID SEQUENCE\n", 17);
+        return;
+    }
+    for (i = 1; i < sequence_length; i++){
+        if (base_class[(unsigned char)sequence[i]] == 0){
+            append_out_buf(out, "INVALID SEQUENCE\n", 17);
+            return;
+        }
+        if (sequence[i] != sequence[run_start]){
+            emit_write(out, sequence[run_start], i - run_start, format);
+            run_start = i;
+        }
+    }
+    emit_write(out, sequence[run_start], i - run_start, format);
+    append_out_buf(out, "SET_TEMPERATURE -1\nEND\n", 23);
+}
@@ -0,0 +1,39 @@
+#ifndef SEQBOT_RENDER
+#define SEQBOT_RENDER
+
+#include "seqbot_melt.h"
+#include "seqbot_output.h"
+
+/* Instruction rendering kernels over ASCII sequences.
+ * Every kernel makes one pass over the sequence that validates it, finds
+ * the runs of equal bases and counts the G/C bases, and appends
+ *     START
+ *     WRITE <base> <run length>   (one line per run)
+ *     SET_TEMPERATURE <t>
+ *     END
+ * to out, or the same instructions in the binary format of seqbot_bin.h
+ * when format is FORMAT_BIN. Return the melting temperature, or -1 if the
+ * sequence is empty or contains characters other than 'A', 'C', 'G', 'T',
+ * in which case out is left as it was.
+ */
+typedef int (*render_fn)(struct out_buf *out, const char *sequence,
+                         int sequence_length, enum output_format format);
+
+int render_scalar(struct out_buf *out, const char *sequence,
+                  int sequence_length, enum output_format format);
+
+#ifdef SEQBOT_X86
+int render_sse2(struct out_buf *out, const char *sequence,
+                int sequence_length, enum output_format format);
+int render_avx2(struct out_buf *out, const char *sequence,
+                int sequence_length, enum output_format format);
+#endif
+
+// render the instructions using the fastest kernel this CPU supports
+int render_instructions(struct out_buf *out, const char *sequence,
+                        int sequence_length, enum output_format format);
+// append what print_instructions prints for an invalid sequence
+void render_invalid(struct out_buf *out, const char *sequence,
+                    int sequence_length, enum output_format format);
+
+#endif
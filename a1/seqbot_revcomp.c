@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include "seqbot_revcomp.h"
+
+#ifdef SEQBOT_X86
+#include <immintrin.h>
+#endif
+
+// the byte each character becomes for modes 0 to 3; modes 2 and 3 also reverse
+static const char mode_table[4][256] = {
+    [0] = {['A'] = 'A', ['C'] = 'C', ['G'] = 'G', ['T'] = 'T'},
+    [1] = {['A'] = 'T', ['C'] = 'G', ['G'] = 'C', ['T'] = 'A'},
+    [2] = {['A'] = 'A', ['C'] = 'C', ['G'] = 'G', ['T'] = 'T'},
+    [3] = {['A'] = 'T', ['C'] = 'G', ['G'] = 'C', ['T'] = 'A'}
+};
+
+/* Scalar kernel: one table lookup per base. For the reversing modes the two
+ * ends are swapped and mapped at the same time, so each base is touched once.
+ */
+void transform_scalar(char *sequence, int sequence_length, int mode)
+{
+    const char *table = mode_table[mode];
+    int i;
+    int j;
+    char tmp;
+
+    if (mode == 0){
+        return;
+    }
+    if (mode == 1){
+        for (i = 0; i < sequence_length; i++){
+            sequence[i] = table[(unsigned char)sequence[i]];
+        }
+        return;
+    }
+    for (i = 0, j = sequence_length - 1; i < j; i++, j--){
+        tmp = table[(unsigned char)sequence[i]];
+        sequence[i] = table[(unsigned char)sequence[j]];
+        sequence[j] = tmp;
+    }
+    if (i == j){
+        sequence[i] = table[(unsigned char)sequence[i]];
+    }
+}
+
+#ifdef SEQBOT_X86
+
+/* Return the complement of the 16 bytes of v, with 0 for any byte that is
+ * not a base.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i complement_ssse3(__m128i v, __m128i low_nibble,
+                                       __m128i complement)
+{
+    __m128i r = _mm_shuffle_epi8(complement, _mm_and_si128(v, low_nibble));
+    __m128i back = _mm_shuffle_epi8(complement, _mm_and_si128(r, low_nibble));
+    return _mm_and_si128(r, _mm_cmpeq_epi8(back, v));
+}
+
+/* SSSE3 kernel: 16 bases at a time with pshufb.
+ * The low nibbles of 'A', 'C', 'G' and 'T' (1, 3, 7, 4) are all different,
+ * so one shuffle on the low nibble looks up the complement of a base. A byte
+ * is a base only if complementing the result gives the byte back; any other
+ * byte becomes 0. A second shuffle with the indices 15..0 reverses a block. The reversing
+ * modes take a block from each end, transform both, and store each at the
+ * other end. What is left in the middle goes to transform_scalar.
+ */
+__attribute__((target("ssse3")))
+void transform_ssse3(char *sequence, int sequence_length, int mode)
+{
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    const __m128i complement = _mm_setr_epi8(0, 'T', 0, 'G', 'A', 0, 0, 'C',
+                                             0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0);
+    int i = 0;
+    int j = sequence_length;
+    __m128i front;
+    __m128i back;
+
+    if (mode == 0){
+        return;
+    }
+    if (mode == 1){
+        for (; i + 16 <= sequence_length; i += 16){
+            front = _mm_loadu_si128((__m128i *)(sequence + i));
+            front = complement_ssse3(front, low_nibble, complement);
+            _mm_storeu_si128((__m128i *)(sequence + i), front);
+        }
+        transform_scalar(sequence + i, sequence_length - i, mode);
+        return;
+    }
+    for (; j - i >= 32; i += 16, j -= 16){
+        front = _mm_loadu_si128((__m128i *)(sequence + i));
+        back = _mm_loadu_si128((__m128i *)(sequence + j - 16));
+        if (mode == 3){
+            front = complement_ssse3(front, low_nibble, complement);
+            back = complement_ssse3(back, low_nibble, complement);
+        }
+        _mm_storeu_si128((__m128i *)(sequence + i), _mm_shuffle_epi8(back, reverse));
+        _mm_storeu_si128((__m128i *)(sequence + j - 16), _mm_shuffle_epi8(front, reverse));
+    }
+    transform_scalar(sequence + i, j - i, mode);
+}
+
+int cpu_has_ssse3(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+#else
+
+int cpu_has_ssse3(void)
+{
+    return 0;
+}
+
+#endif
+
+/* Pick the kernel on the first call and replace the pointer, as
+ * fast_melting_temperature does.
+ */
+static void transform_resolve(char *sequence, int sequence_length, int mode);
+static transform_fn transform_kernel = transform_resolve;
+
+static void transform_resolve(char *sequence, int sequence_length, int mode)
+{
+    transform_fn chosen = transform_scalar;
+#ifdef SEQBOT_X86
+    if (cpu_has_ssse3()){
+        chosen = transform_ssse3;
+    }
+#endif
+    __atomic_store_n(&transform_kernel, chosen, __ATOMIC_RELAXED);
+    chosen(sequence, sequence_length, mode);
+}
+
+void transform_sequence(char *sequence, int sequence_length, int mode)
+{
+    __atomic_load_n(&transform_kernel, __ATOMIC_RELAXED)(sequence, sequence_length, mode);
+}
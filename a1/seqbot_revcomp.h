@@ -0,0 +1,27 @@
+#ifndef SEQBOT_REVCOMP
+#define SEQBOT_REVCOMP
+
+#include "seqbot_melt.h"
+
+/* In-place transforms of ASCII sequences for the genfile modes:
+ *   - 0 leaves the sequence unchanged
+ *   - 1 complements every base
+ *   - 2 reverses the order of the bases
+ *   - 3 does both in one pass
+ * A character other than 'A', 'C', 'G', 'T' is either left as it is or
+ * becomes 0, so an invalid sequence stays invalid after the transform.
+ */
+typedef void (*transform_fn)(char *sequence, int sequence_length, int mode);
+
+void transform_scalar(char *sequence, int sequence_length, int mode);
+
+#ifdef SEQBOT_X86
+void transform_ssse3(char *sequence, int sequence_length, int mode);
+#endif
+
+int cpu_has_ssse3(void);
+
+// transform sequence by mode using the fastest kernel this CPU supports
+void transform_sequence(char *sequence, int sequence_length, int mode);
+
+#endif
@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "seqbot_helpers.h"
+#include "seqbot_reader.h"
+#include "seqbot_revcomp.h"
+#include "seqbot_render.h"
+#include "seqbot_batch.h"
+#include "seqbot_output.h"
+
+// a connection reads its requests this many bytes at a time
+#define SERVE_READ_SIZE (1 << 16)
+// the longest request line a connection reads; a longer one ends it
+#define SERVE_MAX_REQUEST (1 << 24)
+// the most batches of a connection whose replies are not yet written
+#define SERVE_MAX_BATCHES 16
+// the most connections that may wait to be accepted
+#define SERVE_BACKLOG 64
+
+/* The requests of one read from a connection, and the replies to them.
+ *   - index is the position of the batch in the connection, counting from 0
+ *   - requests holds whole lines, and is owned by the batch
+ *   - next links the batch into the queue of the pool, and then into the
+ *     list of batches of its connection that are waiting for their turn
+ *     to be written
+ */
+struct serve_batch {
+    struct serve_connection *connection;
+    long index;
+    char *requests;
+    size_t len;
+    struct out_buf out;
+    struct serve_batch *next;
+};
+
+/* A client of the server. It is read by one thread and written by
+ * another, so a client that does not read its replies holds up only its
+ * own connection.
+ *   - submitted is the number of batches handed to the pool, and written
+ *     the number whose replies have been written, always in order
+ *   - waiting holds the batches that are rendered, to be written in turn
+ *   - reading is 0 once the last batch has been submitted
+ *   - broken is 1 once a write failed, after which replies are dropped
+ */
+struct serve_connection {
+    int fd;
+    long submitted;
+    long written;
+    struct serve_batch *waiting;
+    int reading;
+    int broken;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/* The batches that wait for a worker of the pool, first in first out.
+ */
+struct serve_pool {
+    struct serve_batch *head;
+    struct serve_batch *tail;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static struct serve_pool pool = {
+    .head = NULL, .tail = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER
+};
+
+// the path the server is bound to, removed again when it is stopped
+static char *bound_path;
+
+/* Return the next word of the line at *p, up to end, and its length in
+ * *len, moving *p past it. Return NULL if there are no words left.
+ */
+static char *next_word(char **p, char *end, size_t *len)
+{
+    char *word;
+
+    while (*p < end && (**p == ' ' || **p == '\t' || **p == '\r')){
+        (*p)++;
+    }
+    if (*p == end){
+        return NULL;
+    }
+    word = *p;
+    while (*p < end && **p != ' ' && **p != '\t' && **p != '\r'){
+        (*p)++;
+    }
+    *len = *p - word;
+    return word;
+}
+
+/* Append the reply of seqbot melt for the length bases of sequence to out,
+ * with a newline after an invalid sequence too so that every reply is a
+ * line.
+ */
+static void reply_melt(struct out_buf *out, char *sequence, size_t length,
+                       int nearest_neighbor)
+{
+    size_t offsets[2] = {0, length};
+    struct seqbot_batch batch = {.arena = sequence, .offsets = offsets, .count = 1};
+    char text[32];
+    double tm;
+    int t;
+
+    if (nearest_neighbor){
+        batch_nn_melting_temperatures(&batch, &tm);
+        t = isnan(tm) ? -1 : 0;
+    }
+    else {
+        batch_melting_temperatures(&batch, &t);
+    }
+    if (t < 0){
+        append_out_buf(out, "INVALID SEQUENCE, ", 18);
+        append_out_buf(out, sequence, length);
+        append_out_buf(out, "\n", 1);
+        return;
+    }
+    append_out_buf(out, "The melting temperature of ", 27);
+    append_out_buf(out, sequence, length);
+    append_out_buf(out, " is ", 4);
+    if (nearest_neighbor){
+        append_out_buf(out, text, snprintf(text, sizeof(text), "%.1f", tm));
+    }
+    else {
+        append_int_out_buf(out, t);
+    }
+    append_out_buf(out, "\n", 1);
+}
+
+/* Append the reply to the request in the line from line to end to out.
+ * The line may be changed, as a genfile record is transformed in place.
+ */
+static void serve_request(struct out_buf *out, char *line, char *end)
+{
+    struct genfile_record record;
+    char *p = line;
+    char *word;
+    size_t len;
+
+    word = next_word(&p, end, &len);
+    if (word == NULL){
+        append_out_buf(out, "ERROR empty request\n", 20);
+        return;
+    }
+    if (len == 4 && memcmp(word, "melt", 4) == 0){
+        int nearest_neighbor = 0;
+        word = next_word(&p, end, &len);
+        if (word != NULL && len == 13 && memcmp(word, "--tm-model=nn", 13) == 0){
+            nearest_neighbor = 1;
+            word = next_word(&p, end, &len);
+        }
+        if (word == NULL){
+            append_out_buf(out, "ERROR melt needs a sequence\n", 28);
+            return;
+        }
+        reply_melt(out, word, len, nearest_neighbor);
+        return;
+    }
+    if (len == 5 && memcmp(word, "print", 5) == 0){
+        word = next_word(&p, end, &len);
+        if (word == NULL){
+            append_out_buf(out, "ERROR print needs a sequence\n", 29);
+            return;
+        }
+        if (len > INT_MAX){
+            render_invalid(out, word, -1, FORMAT_TEXT);
+        }
+        else if (render_instructions(out, word, len, FORMAT_TEXT) < 0){
+            render_invalid(out, word, len, FORMAT_TEXT);
+        }
+        return;
+    }
+    if (parse_line_record(line, end, &record) != 0){
+        append_out_buf(out, "ERROR unknown request\n", 22);
+        return;
+    }
+    // the checks of render_record in seqbot_genfile.c
+    if (record.length != record.sequence_len || record.length <= 0
+        || record.length > INT_MAX || record.mode < 0 || record.mode > 3){
+        append_out_buf(out, "INVALID SEQUENCE\n", 17);
+        return;
+    }
+    transform_sequence(record.sequence, record.length, record.mode);
+    if (render_instructions(out, record.sequence, record.length, FORMAT_TEXT) < 0){
+        append_out_buf(out, "INVALID SEQUENCE\n", 17);
+    }
+}
+
+/* Write n bytes of data to the socket fd. Return -1 if the client has gone
+ * away or the write failed, rather than exiting as write_all does.
+ */
+static int send_all(int fd, const char *data, size_t n)
+{
+    ssize_t sent;
+
+    while (n > 0){
+        sent = send(fd, data, n, MSG_NOSIGNAL);
+        if (sent < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        n -= sent;
+    }
+    return 0;
+}
+
+/* Hand batch, whose replies are rendered, to the writer of its
+ * connection.
+ */
+static void finish_batch(struct serve_batch *batch)
+{
+    struct serve_connection *connection = batch->connection;
+
+    pthread_mutex_lock(&connection->lock);
+    batch->next = connection->waiting;
+    connection->waiting = batch;
+    pthread_cond_broadcast(&connection->cond);
+    pthread_mutex_unlock(&connection->lock);
+}
+
+/* Write the replies of the batches of a connection in order, each once it
+ * is rendered and the ones before it are written, until the last one is
+ * written. The writes are done without the lock, so the pool and the
+ * reader of the connection are never held up by a slow client.
+ */
+static void *serve_writer_main(void *arg)
+{
+    struct serve_connection *connection = arg;
+    struct serve_batch **link;
+    struct serve_batch *batch;
+
+    pthread_mutex_lock(&connection->lock);
+    while (connection->reading || connection->written < connection->submitted){
+        link = &connection->waiting;
+        while (*link != NULL && (*link)->index != connection->written){
+            link = &(*link)->next;
+        }
+        if (*link == NULL){
+            pthread_cond_wait(&connection->cond, &connection->lock);
+            continue;
+        }
+        batch = *link;
+        *link = batch->next;
+        pthread_mutex_unlock(&connection->lock);
+        if (!connection->broken
+            && send_all(connection->fd, batch->out.data, batch->out.len) != 0){
+            connection->broken = 1;
+        }
+        free(batch->requests);
+        free_out_buf(&batch->out);
+        free(batch);
+        pthread_mutex_lock(&connection->lock);
+        connection->written++;
+        pthread_cond_broadcast(&connection->cond);
+    }
+    pthread_mutex_unlock(&connection->lock);
+    return NULL;
+}
+
+/* Take batches from the pool, answer every request in them, and hand
+ * them to the writers of their connections.
+ */
+static void *serve_worker_main(void *arg)
+{
+    struct serve_batch *batch;
+    char *line;
+    char *end;
+    char *newline;
+
+    (void)arg;
+    while (1){
+        pthread_mutex_lock(&pool.lock);
+        while (pool.head == NULL){
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        }
+        batch = pool.head;
+        pool.head = batch->next;
+        if (pool.head == NULL){
+            pool.tail = NULL;
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        line = batch->requests;
+        end = batch->requests + batch->len;
+        while (line < end){
+            newline = memchr(line, '\n', end - line);
+            if (newline == NULL){
+                newline = end;
+            }
+            serve_request(&batch->out, line, newline);
+            line = newline + 1;
+        }
+        finish_batch(batch);
+    }
+    return NULL;
+}
+
+/* Return a new batch of connection for the len bytes of requests, which
+ * it takes over, once fewer than SERVE_MAX_BATCHES batches of connection
+ * are waiting to be written.
+ */
+static struct serve_batch *create_batch(struct serve_connection *connection,
+                                        char *requests, size_t len)
+{
+    struct serve_batch *batch = malloc(sizeof(struct serve_batch));
+
+    if (batch == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    pthread_mutex_lock(&connection->lock);
+    while (connection->submitted - connection->written >= SERVE_MAX_BATCHES){
+        pthread_cond_wait(&connection->cond, &connection->lock);
+    }
+    batch->index = connection->submitted++;
+    pthread_mutex_unlock(&connection->lock);
+    batch->connection = connection;
+    batch->requests = requests;
+    batch->len = len;
+    init_out_buf(&batch->out);
+    batch->next = NULL;
+    return batch;
+}
+
+/* Hand the len bytes of requests, which the batch takes over, to the pool
+ * as the next batch of connection, once the connection has room for it.
+ */
+static void submit_batch(struct serve_connection *connection, char *requests,
+                         size_t len)
+{
+    struct serve_batch *batch = create_batch(connection, requests, len);
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.tail == NULL){
+        pool.head = batch;
+    }
+    else {
+        pool.tail->next = batch;
+    }
+    pool.tail = batch;
+    pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/* Read the requests of one client and submit them to the pool. All of the
+ * whole lines that one read completes go to the pool as one batch, so
+ * requests that are pipelined are answered together, while a single
+ * request is handed over as soon as its line ends. A last line without a
+ * newline is a request too. Once the client has finished sending and every
+ * reply is written the connection is closed.
+ *
+ * Reading waits while SERVE_MAX_BATCHES batches are not yet written, so a
+ * client that sends without reading its replies is held up by the socket.
+ * A line longer than SERVE_MAX_REQUEST gets an error reply, and nothing
+ * after it is read.
+ */
+static void *serve_connection_main(void *arg)
+{
+    struct serve_connection *connection = arg;
+    struct serve_batch *batch;
+    size_t capacity = SERVE_READ_SIZE;
+    char *buf = malloc(capacity);
+    char *rest;
+    size_t len = 0;
+    size_t whole;
+    ssize_t n;
+
+    if (pthread_create(&connection->writer, NULL, serve_writer_main, connection) != 0){
+        perror("pthread_create");
+        exit(1);
+    }
+    while (1){
+        if (buf == NULL){
+            perror("malloc");
+            exit(1);
+        }
+        if (len > SERVE_MAX_REQUEST){
+            batch = create_batch(connection, NULL, 0);
+            append_out_buf(&batch->out, "ERROR request too long\n", 23);
+            finish_batch(batch);
+            len = 0;
+            break;
+        }
+        if (capacity - len < SERVE_READ_SIZE / 2){
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+            continue;
+        }
+        // a partial line never grows past SERVE_MAX_REQUEST + 1 bytes
+        n = capacity - len < SERVE_MAX_REQUEST + 1 - len ? capacity - len
+                                                         : SERVE_MAX_REQUEST + 1 - len;
+        n = read(connection->fd, buf + len, n);
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            break;
+        }
+        // only the new bytes can hold the last newline
+        whole = len + n;
+        while (whole > len && buf[whole - 1] != '\n'){
+            whole--;
+        }
+        len += n;
+        if (whole == 0 || buf[whole - 1] != '\n'){
+            continue;
+        }
+        // the rest of a long line keeps its room; otherwise start small again
+        len -= whole;
+        capacity = SERVE_READ_SIZE;
+        while (capacity - len < SERVE_READ_SIZE / 2){
+            capacity *= 2;
+        }
+        rest = malloc(capacity);
+        if (rest != NULL){
+            memcpy(rest, buf + whole, len);
+            submit_batch(connection, buf, whole);
+        }
+        buf = rest;
+    }
+    if (len > 0){
+        submit_batch(connection, buf, len);
+    }
+    else {
+        free(buf);
+    }
+
+    pthread_mutex_lock(&connection->lock);
+    connection->reading = 0;
+    pthread_cond_broadcast(&connection->cond);
+    pthread_mutex_unlock(&connection->lock);
+    pthread_join(connection->writer, NULL);
+    close(connection->fd);
+    pthread_cond_destroy(&connection->cond);
+    pthread_mutex_destroy(&connection->lock);
+    free(connection);
+    return NULL;
+}
+
+/* Remove the socket and stop, on SIGINT or SIGTERM.
+ */
+static void stop_serving(int signal_number)
+{
+    (void)signal_number;
+    unlink(bound_path);
+    _exit(0);
+}
+
+/* Answer requests sent to the Unix domain socket at socket_path, one per
+ * line, until the server is stopped with SIGINT or SIGTERM. The requests
+ * and their replies are:
+ *     melt [--tm-model=nn] <sequence>
+ *         the line seqbot melt prints, or "INVALID SEQUENCE, <sequence>"
+ *     print <sequence>
+ *         the instructions seqbot print prints
+ *     <length> <sequence> <mode>
+ *         the instructions seqbot genfile prints for the record, or
+ *         "INVALID SEQUENCE" where genfile would stop
+ *     anything else
+ *         "ERROR <reason>"
+ * Every reply ends with a newline, and the replies on a connection come in
+ * the order of its requests, so a client may send many requests before it
+ * reads the replies.
+ *
+ * Each client is read by a thread of its own, and the requests are
+ * answered by a pool of opts->num_threads workers. The replies are written
+ * by another thread of the client, to a batch of requests as soon as the
+ * replies before them are written, so workers never wait on a client. A socket file left at socket_path by an earlier server is
+ * replaced; any other file there is an error.
+ */
+void serve_requests(char *socket_path, struct serve_options *opts)
+{
+    struct serve_connection *connection;
+    struct sockaddr_un address;
+    struct stat st;
+    pthread_t thread;
+    int listener;
+    int fd;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "serve: %s: socket path is too long\n", socket_path);
+        exit(1);
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)){
+        unlink(socket_path);
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0){
+        perror("socket");
+        exit(1);
+    }
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0){
+        perror(socket_path);
+        exit(1);
+    }
+    if (listen(listener, SERVE_BACKLOG) != 0){
+        perror("listen");
+        exit(1);
+    }
+    bound_path = socket_path;
+    signal(SIGINT, stop_serving);
+    signal(SIGTERM, stop_serving);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < opts->num_threads; i++){
+        if (pthread_create(&thread, NULL, serve_worker_main, NULL) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+    while (1){
+        fd = accept(listener, NULL, NULL);
+        if (fd < 0){
+            if (errno == EINTR || errno == ECONNABORTED){
+                continue;
+            }
+            perror("accept");
+            exit(1);
+        }
+        connection = malloc(sizeof(struct serve_connection));
+        if (connection == NULL){
+            perror("malloc");
+            exit(1);
+        }
+        connection->fd = fd;
+        connection->submitted = 0;
+        connection->written = 0;
+        connection->waiting = NULL;
+        connection->reading = 1;
+        connection->broken = 0;
+        pthread_mutex_init(&connection->lock, NULL);
+        pthread_cond_init(&connection->cond, NULL);
+        if (pthread_create(&thread, NULL, serve_connection_main, connection) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "seqbot_helpers.h"
+
+// the largest k whose counts and byte sizes fit in 128 bits
+#define STATS_MAX_K 60
+
+typedef unsigned __int128 count_t;
+
+/* Print n in decimal.
+ */
+static void print_count(count_t n)
+{
+    char digits[40];
+    int i = 0;
+    do {
+        digits[i++] = '0' + (int)(n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0){
+        putchar(digits[--i]);
+    }
+}
+
+/* Print how many of the 4^k molecules of length k there are at each
+ * melting temperature and with each number of runs, and how many bytes
+ * generate_all_molecules(k) would write. Nothing is enumerated:
+ *   - a molecule with g G/C bases has temperature 2k + 2g, and there are
+ *     C(k, g) ways to place them and 2 choices of base at every position,
+ *     so C(k, g) * 2^k molecules have that temperature
+ *   - a molecule with r runs has r - 1 run boundaries among its k - 1 gaps,
+ *     4 choices for the first run and 3 for each run after it, so there
+ *     are C(k - 1, r - 1) * 4 * 3^(r - 1) of them
+ *   - every line of genall is "<k> <sequence> 0\n"
+ * The output is one "<name> <value>" line per figure:
+ *     molecules <4^k>
+ *     genall_bytes <bytes>
+ *     temperature <t> <count>    for each temperature t
+ *     runs <r> <count>           for each number of runs r
+ */
+void print_genall_stats(int k)
+{
+    count_t binomial[STATS_MAX_K + 1][STATS_MAX_K + 1] = {{0}};
+    count_t pow3 = 1;
+    count_t molecules;
+    int line_len;
+
+    if (k <= 0 || k > STATS_MAX_K){
+        fprintf(stderr, "stats: size must be between 1 and %d\n", STATS_MAX_K);
+        exit(1);
+    }
+    molecules = (count_t)1 << (2 * k);
+    for (int n = 0; n <= k; n++){
+        binomial[n][0] = 1;
+        for (int r = 1; r <= n; r++){
+            binomial[n][r] = binomial[n - 1][r - 1] + binomial[n - 1][r];
+        }
+    }
+    line_len = snprintf(NULL, 0, "%d ", k) + k + 3;
+
+    printf("molecules ");
+    print_count(molecules);
+    printf("\ngenall_bytes ");
+    print_count(molecules * line_len);
+    printf("\n");
+    for (int g = 0; g <= k; g++){
+        printf("temperature %d ", 2 * k + 2 * g);
+        print_count(binomial[k][g] << k);
+        printf("\n");
+    }
+    for (int r = 1; r <= k; r++){
+        printf("runs %d ", r);
+        print_count(binomial[k - 1][r - 1] * 4 * pow3);
+        printf("\n");
+        pow3 *= 3;
+    }
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seqbot_batch.h"
+#include "seqbot_melt.h"
+#include "seqbot_nn.h"
+#include "seqbot_render.h"
+#include "test_util.h"
+
+/* Check the batch entry points of libseqbot against the functions they
+ * call for one sequence at a time. The arena starts with bytes that are
+ * not part of any sequence and holds valid, invalid and empty sequences
+ * back to back, some of them alternating bases so that every run is one
+ * base long, which is the most output a sequence can need. Every entry
+ * point is run on the whole batch and on every batch of its last n
+ * sequences, down to one. The instructions are rendered with room for
+ * exactly batch_instructions_bound bytes and with less, past which nothing
+ * may be written. Prints "Test passed" or the first mismatch.
+ */
+
+#define NUM_SEQUENCES 60
+// bytes at the start of the arena before the first sequence
+#define ARENA_SKIP 13
+#define MAX_SEQUENCE_LEN 200
+// the byte that fills out beyond the capacity it is given
+#define CANARY 0x5A
+
+static char arena[ARENA_SKIP + NUM_SEQUENCES * MAX_SEQUENCE_LEN];
+static size_t offsets[NUM_SEQUENCES + 1];
+
+/* Fill arena with NUM_SEQUENCES sequences of different kinds and set
+ * offsets to where they are.
+ */
+static void fill_arena(void)
+{
+    char *sequence;
+    int length;
+
+    memset(arena, 'A', ARENA_SKIP);
+    offsets[0] = ARENA_SKIP;
+    for (int i = 0; i < NUM_SEQUENCES; i++){
+        sequence = arena + offsets[i];
+        length = 1 + rand() % MAX_SEQUENCE_LEN;
+        switch (i % 5){
+        case 0:
+            random_bases(sequence, length);
+            break;
+        case 1:
+            for (int j = 0; j < length; j++){
+                sequence[j] = "CG"[j % 2];
+            }
+            break;
+        case 2:
+            length = 0;
+            break;
+        case 3:
+            random_bases(sequence, length);
+            sequence[rand() % length] = bad_byte(i);
+            break;
+        case 4:
+            random_runs(sequence, length, 8);
+            break;
+        }
+        offsets[i + 1] = offsets[i] + length;
+    }
+}
+
+/* Check the temperatures and validity batch gives for each of its
+ * sequences. Return 1 if they match the single sequence functions.
+ */
+static int check_values(const struct seqbot_batch *batch)
+{
+    int temperatures[NUM_SEQUENCES];
+    double nn_temperatures[NUM_SEQUENCES];
+    unsigned char valid[NUM_SEQUENCES];
+    const char *sequence;
+    int length;
+    int t;
+    double tm;
+
+    batch_melting_temperatures(batch, temperatures);
+    batch_nn_melting_temperatures(batch, nn_temperatures);
+    batch_validate(batch, valid);
+    for (size_t i = 0; i < batch->count; i++){
+        sequence = batch->arena + batch->offsets[i];
+        length = batch->offsets[i + 1] - batch->offsets[i];
+        t = fast_melting_temperature(sequence, length);
+        if (nn_melting_temperature(sequence, length, &tm) < 0){
+            tm = NAN;
+        }
+        if (temperatures[i] != t || valid[i] != (t >= 0)
+            || (isnan(tm) ? !isnan(nn_temperatures[i]) : nn_temperatures[i] != tm)){
+            printf("Test failed: sequence %zu (%.*s) gave %d %f %d, expected %d %f %d\n",
+                   i, length, sequence, temperatures[i], nn_temperatures[i], valid[i],
+                   t, tm, t >= 0);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Render batch into capacity bytes of out and check that what is rendered
+ * is what render_instructions, or render_invalid for an invalid sequence,
+ * appends for each sequence, that it is within the bound of each sequence,
+ * that nothing is written past capacity, and that rendering only stopped
+ * at a sequence whose bound did not fit. rendered is set to the number of
+ * sequences rendered. Return 1 if it all holds.
+ */
+static int check_render(const struct seqbot_batch *batch, enum output_format format,
+                        char *out, size_t capacity, size_t *rendered)
+{
+    size_t out_offsets[NUM_SEQUENCES + 1];
+    int temperatures[NUM_SEQUENCES];
+    struct seqbot_batch one;
+    struct out_buf expected;
+    const char *sequence;
+    int length;
+    int t;
+    int ok = 1;
+
+    memset(out, CANARY, capacity + 64);
+    *rendered = batch_render_instructions(batch, format, out, capacity,
+                                          out_offsets, temperatures);
+    for (size_t i = capacity; i < capacity + 64; i++){
+        if ((unsigned char)out[i] != CANARY){
+            printf("Test failed: byte %zu written past a capacity of %zu\n", i, capacity);
+            return 0;
+        }
+    }
+    init_out_buf(&expected);
+    for (size_t i = 0; i < *rendered && ok; i++){
+        sequence = batch->arena + batch->offsets[i];
+        length = batch->offsets[i + 1] - batch->offsets[i];
+        one.arena = batch->arena;
+        one.offsets = batch->offsets + i;
+        one.count = 1;
+        expected.len = 0;
+        t = render_instructions(&expected, sequence, length, format);
+        if (t < 0){
+            render_invalid(&expected, sequence, length, format);
+        }
+        if (temperatures[i] != t || out_offsets[i + 1] - out_offsets[i] != expected.len
+            || memcmp(out + out_offsets[i], expected.data, expected.len) != 0){
+            printf("Test failed: sequence %zu (%.*s) rendered differently (%s)\n",
+                   i, length, sequence, format == FORMAT_BIN ? "bin" : "text");
+            ok = 0;
+        }
+        else if (expected.len > batch_instructions_bound(&one, format)){
+            printf("Test failed: sequence %zu (%.*s) took %zu bytes, over its bound of %zu\n",
+                   i, length, sequence, expected.len, batch_instructions_bound(&one, format));
+            ok = 0;
+        }
+    }
+    free_out_buf(&expected);
+    one.arena = batch->arena;
+    one.offsets = batch->offsets + *rendered;
+    one.count = 1;
+    if (ok && *rendered < batch->count
+        && batch_instructions_bound(&one, format) <= capacity - out_offsets[*rendered]){
+        printf("Test failed: stopped at sequence %zu with room for it\n", *rendered);
+        ok = 0;
+    }
+    return ok;
+}
+
+/* Check batch in both formats. Return 1 if it passes.
+ */
+static int check_batch(const struct seqbot_batch *batch)
+{
+    enum output_format formats[2] = {FORMAT_TEXT, FORMAT_BIN};
+    size_t bound;
+    size_t rendered;
+    char *out;
+    int ok = check_values(batch);
+
+    for (int f = 0; f < 2 && ok; f++){
+        bound = batch_instructions_bound(batch, formats[f]);
+        out = malloc(bound + 64);
+        if (out == NULL){
+            perror("malloc");
+            exit(1);
+        }
+        ok = check_render(batch, formats[f], out, bound, &rendered);
+        if (ok && rendered != batch->count){
+            printf("Test failed: rendered %zu of %zu sequences with room for the bound\n",
+                   rendered, batch->count);
+            ok = 0;
+        }
+        for (size_t capacity = bound / 2; capacity > 0 && ok; capacity /= 3){
+            ok = check_render(batch, formats[f], out, capacity, &rendered);
+        }
+        free(out);
+    }
+    return ok;
+}
+
+int main(void)
+{
+    struct seqbot_batch batch = {.arena = arena, .offsets = offsets, .count = NUM_SEQUENCES};
+    struct seqbot_batch rest;
+    int ok;
+
+    seed_random(19);
+    fill_arena();
+    ok = check_batch(&batch);
+    for (size_t skip = 1; skip < NUM_SEQUENCES && ok; skip++){
+        rest.arena = arena;
+        rest.offsets = offsets + skip;
+        rest.count = NUM_SEQUENCES - skip;
+        ok = check_batch(&rest);
+    }
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include "seqbot_melt.h"
+#include "test_util.h"
+
+/* Check every melting temperature kernel this CPU supports, melt_scalar
+ * included, against a count of the bases done here. The vector kernels
+ * work in blocks of 16 or 32 bases and leave a tail to the next smaller
+ * kernel, so the lengths go past several whole blocks, the sequences
+ * include ones that are all one base (every lane of the G/C mask set or
+ * none), and invalid bytes go at the first and last byte of each block and
+ * anywhere in the tail. Prints "Test passed" or the first mismatch found.
+ */
+
+// enough for eight AVX2 blocks and the longest tail
+#define MAX_LEN (8 * 32 + 31)
+
+static char seq[MAX_LEN];
+
+/* The temperature of the first length bytes of seq by the Wallace rule,
+ * 2 per A/T and 4 per G/C, or -1 if they are empty or not all bases.
+ */
+static int wallace(int length)
+{
+    int at = 0;
+    int gc = 0;
+
+    for (int i = 0; i < length; i++){
+        if (seq[i] == 'A' || seq[i] == 'T'){
+            at++;
+        } else if (seq[i] == 'C' || seq[i] == 'G'){
+            gc++;
+        } else {
+            return -1;
+        }
+    }
+    return length == 0 ? -1 : 2 * at + 4 * gc;
+}
+
+/* Compare kernel against wallace on the first length bytes of seq.
+ * Return 1 if they agree.
+ */
+static int check(const char *name, melt_fn kernel, int length)
+{
+    int expected = wallace(length);
+    int actual = kernel(seq, length);
+    if (actual != expected){
+        printf("Test failed: %s returned %d for %.*s, expected %d\n",
+               name, actual, length, seq, expected);
+        return 0;
+    }
+    return 1;
+}
+
+/* Return 1 if an invalid byte at pos is at a block edge or in the tail
+ * of a sequence of length bases for some kernel.
+ */
+static int edge(int pos, int length)
+{
+    return pos % 16 == 0 || pos % 16 == 15 || pos >= length / 16 * 16;
+}
+
+int main(void)
+{
+    const char *bases = "ACGT";
+    melt_fn kernels[4];
+    const char *names[4];
+    int num_kernels = 0;
+    int ok = 1;
+
+    names[num_kernels] = "scalar";
+    kernels[num_kernels++] = melt_scalar;
+    names[num_kernels] = "dispatch";
+    kernels[num_kernels++] = fast_melting_temperature;
+#ifdef SEQBOT_X86
+    if (cpu_has_sse2()){
+        names[num_kernels] = "sse2";
+        kernels[num_kernels++] = melt_sse2;
+    }
+    if (cpu_has_avx2()){
+        names[num_kernels] = "avx2";
+        kernels[num_kernels++] = melt_avx2;
+    }
+#endif
+
+    seed_random(2);
+    for (int len = 0; len <= MAX_LEN && ok; len++){
+        for (int k = 0; k < num_kernels && ok; k++){
+            for (int b = 0; b < 4 && ok; b++){
+                for (int i = 0; i < len; i++){
+                    seq[i] = bases[b];
+                }
+                ok = check(names[k], kernels[k], len);
+            }
+            random_bases(seq, len);
+            if (ok){
+                ok = check(names[k], kernels[k], len);
+            }
+            for (int pos = 0; pos < len && ok; pos++){
+                if (!edge(pos, len)){
+                    continue;
+                }
+                char saved = seq[pos];
+                seq[pos] = bad_byte(pos);
+                ok = check(names[k], kernels[k], len);
+                seq[pos] = saved;
+            }
+        }
+    }
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
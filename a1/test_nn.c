@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "seqbot_nn.h"
+#include "seqbot_revcomp.h"
+#include "test_util.h"
+
+/* Check every nearest-neighbor kernel this CPU supports on each of the 16
+ * pairs of bases. The SSSE3 kernel looks up the pairs that start in a
+ * block of 16 bases, one per lane, and leaves the last 1 to 16 pairs to the
+ * scalar loop, so the cases are:
+ *   - a sequence holding every pair, shifted so that every pair lands in
+ *     every lane and in the scalar tail, against nn_scalar
+ *   - every kernel against the sum of the stacks of each two bases alone
+ *   - every pair against its reverse complement, which is the same stack
+ *   - an invalid byte at the first and last base of each block and
+ *     anywhere in the tail, which must give -1
+ * then that nn_melting_temperature gives known temperatures.
+ * Prints "Test passed" or the first mismatch found.
+ */
+
+// enough for six SSSE3 blocks and the longest tail
+#define MAX_LEN (6 * 16 + 17)
+
+// each of the 16 pairs of bases starts at one position of this, wrapping
+static const char all_pairs[] = "AACAGATCCGCTGGTT";
+
+static char seq[MAX_LEN];
+
+/* Compare kernel against nn_scalar on the first length bytes of seq.
+ * Return 1 if they agree.
+ */
+static int check(const char *name, nn_fn kernel, int length)
+{
+    struct nn_sums expected;
+    struct nn_sums actual;
+    int expected_ret = nn_scalar(seq, length, &expected);
+    int actual_ret = kernel(seq, length, &actual);
+    if (actual_ret != expected_ret
+        || (expected_ret == 0 && (actual.enthalpy != expected.enthalpy
+                                  || actual.entropy != expected.entropy))){
+        printf("Test failed: %s returned %d (%ld, %ld), scalar returned %d (%ld, %ld) for %.*s\n",
+               name, actual_ret, actual.enthalpy, actual.entropy,
+               expected_ret, expected.enthalpy, expected.entropy, length, seq);
+        return 0;
+    }
+    return 1;
+}
+
+/* Compare kernel on the first length bases of seq against the stacks of
+ * each two neighboring bases added up. Return 1 if they agree.
+ */
+static int check_stacks(const char *name, nn_fn kernel, int length)
+{
+    struct nn_sums expected = {0, 0};
+    struct nn_sums pair;
+    struct nn_sums actual;
+
+    for (int i = 0; i + 1 < length; i++){
+        nn_scalar(seq + i, 2, &pair);
+        expected.enthalpy += pair.enthalpy;
+        expected.entropy += pair.entropy;
+    }
+    if (kernel(seq, length, &actual) != 0 || actual.enthalpy != expected.enthalpy
+        || actual.entropy != expected.entropy){
+        printf("Test failed: %s gave (%ld, %ld) for %.*s, its stacks add up to (%ld, %ld)\n",
+               name, actual.enthalpy, actual.entropy, length, seq,
+               expected.enthalpy, expected.entropy);
+        return 0;
+    }
+    return 1;
+}
+
+/* Check that each pair has the same stack as its reverse complement.
+ * Return 1 if every pair does.
+ */
+static int check_symmetry(void)
+{
+    char pair[2];
+    struct nn_sums forward;
+    struct nn_sums reverse;
+
+    for (int i = 0; i < 16; i++){
+        pair[0] = all_pairs[i];
+        pair[1] = all_pairs[(i + 1) % 16];
+        nn_scalar(pair, 2, &forward);
+        transform_sequence(pair, 2, 3);
+        nn_scalar(pair, 2, &reverse);
+        if (forward.enthalpy != reverse.enthalpy || forward.entropy != reverse.entropy){
+            printf("Test failed: %c%c and %.2s have different stacks\n",
+                   all_pairs[i], all_pairs[(i + 1) % 16], pair);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Return 1 if an invalid byte at pos is at the first or last base of a
+ * block, or in the tail, of a sequence of length bases.
+ */
+static int edge(int pos, int length)
+{
+    return pos % 16 == 0 || pos % 16 == 15 || pos >= (length - 1) / 16 * 16;
+}
+
+// how far a temperature may be from the known one, in degrees C
+#define TM_TOLERANCE 0.01
+
+/* A sequence and its melting temperature under the unified parameters of
+ * SantaLucia (1998) at NN_STRAND_CONCENTRATION and NN_SODIUM_CONCENTRATION,
+ * as given by the independent Tm_NN of Biopython (table DNA_NN3, salt
+ * correction 5), or NAN if nn_melting_temperature must reject it.
+ * Together they cover all ten stacks, both kinds of end and both kinds of
+ * strand concentration term.
+ */
+struct tm_case {
+    const char *sequence;
+    double tm;
+};
+
+static const struct tm_case tm_cases[] = {
+    {"CGCGAATTCGCG", 43.763},            // self-complementary
+    {"GGACTGACGATCGTA", 42.430},
+    {"ATGCAGTCAAGCTTGCA", 48.819},
+    {"CAAAAAG", -9.429},
+    {"ACGTGCATTCAGGTCCATAG", 51.915},
+    {"TTTTTTTTTTTT", 16.348},
+    {"GCGC", -22.547},                   // self-complementary, G/C ends
+    {"AT", -219.103},                    // the shortest valid sequence
+    {"A", NAN},
+    {"", NAN},
+    {"ACGN", NAN},
+    {"acgt", NAN}
+};
+
+/* Check nn_melting_temperature against tm_cases. Return 1 if every case
+ * matches.
+ */
+static int check_known(void)
+{
+    size_t n = sizeof(tm_cases) / sizeof(tm_cases[0]);
+    const struct tm_case *c;
+    double tm = 0;
+    int ret;
+
+    for (size_t i = 0; i < n; i++){
+        c = &tm_cases[i];
+        ret = nn_melting_temperature(c->sequence, strlen(c->sequence), &tm);
+        if (isnan(c->tm) ? ret != -1 : ret != 0 || fabs(tm - c->tm) > TM_TOLERANCE){
+            printf("Test failed: nn_melting_temperature of \"%s\" returned %d (%.3f), expected %.3f\n",
+                   c->sequence, ret, tm, c->tm);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(void)
+{
+    nn_fn kernels[3];
+    const char *names[3];
+    int num_kernels = 0;
+    int ok = 1;
+
+    names[num_kernels] = "scalar";
+    kernels[num_kernels++] = nn_scalar;
+    names[num_kernels] = "dispatch";
+    kernels[num_kernels++] = nn_stack_sums;
+#ifdef SEQBOT_X86
+    if (cpu_has_ssse3()){
+        names[num_kernels] = "ssse3";
+        kernels[num_kernels++] = nn_ssse3;
+    }
+#endif
+
+    ok = check_symmetry();
+    seed_random(20);
+    for (int len = 0; len <= MAX_LEN && ok; len++){
+        for (int k = 0; k < num_kernels && ok; k++){
+            for (int shift = 0; shift < 16 && ok; shift++){
+                for (int i = 0; i < len; i++){
+                    seq[i] = all_pairs[(i + shift) % 16];
+                }
+                ok = check(names[k], kernels[k], len);
+            }
+            random_bases(seq, len);
+            if (ok){
+                ok = check(names[k], kernels[k], len);
+            }
+            if (ok && len >= 2){
+                ok = check_stacks(names[k], kernels[k], len);
+            }
+            for (int pos = 0; pos < len && ok; pos++){
+                if (!edge(pos, len)){
+                    continue;
+                }
+                char saved = seq[pos];
+                seq[pos] = bad_byte(pos);
+                ok = check(names[k], kernels[k], len);
+                seq[pos] = saved;
+            }
+        }
+    }
+    if (ok){
+        ok = check_known();
+    }
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
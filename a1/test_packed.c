@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include "seqbot_packed.h"
+#include "test_util.h"
+
+/* Check the packed sequence type against the ASCII sequence it was packed
+ * from, for lengths on both sides of each word boundary:
+ *   - decoding any range of bases gives back the characters
+ *   - get_base and first_difference agree with the characters
+ *   - an invalid byte anywhere is rejected and leaves the packed sequence
+ *     as it was
+ *   - complementing gives the complement of every base and keeps the bits
+ *     past the last base 0, so equal sequences still have equal words
+ * Prints "Test passed" or the first mismatch found.
+ */
+
+// enough for four words and a part of a fifth
+#define MAX_LEN (4 * BASES_PER_WORD + 17)
+
+static char seq[MAX_LEN];
+static char decoded[MAX_LEN];
+
+/* Check that packed holds the first length characters of seq, decoding it
+ * whole and from every base to the end. Return 1 if it does.
+ */
+static int check_decode(struct packed_seq *packed, int length)
+{
+    if (packed->length != length){
+        printf("Test failed: length %d, expected %d\n", packed->length, length);
+        return 0;
+    }
+    for (int from = 0; from < length; from++){
+        decode_sequence(packed, from, length, decoded);
+        if (memcmp(decoded, seq + from, length - from) != 0){
+            printf("Test failed: decoded %.*s from %d of %.*s\n",
+                   length - from, decoded, from, length, seq);
+            return 0;
+        }
+        if (base_char[get_base(packed, from)] != seq[from]){
+            printf("Test failed: base %d of %.*s\n", from, length, seq);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Pack seq with one base changed at each position in turn and check that
+ * first_difference finds it. Return 1 if it does every time.
+ */
+static int check_difference(struct packed_seq *packed, struct packed_seq *other,
+                            int length)
+{
+    int found;
+
+    for (int pos = 0; pos < length; pos++){
+        char saved = seq[pos];
+        seq[pos] = saved == 'A' ? 'G' : 'A';
+        encode_sequence(seq, length, other);
+        seq[pos] = saved;
+        found = first_difference(packed, other);
+        if (found != pos){
+            printf("Test failed: first difference %d, expected %d in %.*s\n",
+                   found, pos, length, seq);
+            return 0;
+        }
+    }
+    encode_sequence(seq, length, other);
+    if (first_difference(packed, other) != length){
+        printf("Test failed: %.*s differs from itself\n", length, seq);
+        return 0;
+    }
+    return 1;
+}
+
+/* Check that an invalid byte at any position is rejected without changing
+ * packed. Return 1 if it is.
+ */
+static int check_invalid(struct packed_seq *packed, int length)
+{
+    for (int pos = 0; pos < length; pos++){
+        char saved = seq[pos];
+        seq[pos] = bad_byte(pos);
+        if (encode_sequence(seq, length, packed) != -1){
+            printf("Test failed: %.*s was packed\n", length, seq);
+            return 0;
+        }
+        seq[pos] = saved;
+        if (!check_decode(packed, length)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Complement packed and seq, and compare them, including the words
+ * against seq packed afresh. Return 1 if they agree.
+ */
+static int check_complement(struct packed_seq *packed, struct packed_seq *other,
+                            int length)
+{
+    for (int i = 0; i < length; i++){
+        seq[i] = base_char[base_code[(unsigned char)seq[i]] ^ 3];
+    }
+    complement_packed(packed);
+    encode_sequence(seq, length, other);
+    if (!check_decode(packed, length)){
+        return 0;
+    }
+    if (memcmp(packed->words, other->words, PACKED_WORDS(length) * sizeof(uint64_t)) != 0){
+        printf("Test failed: the complement of %.*s has bits past its end\n", length, seq);
+        return 0;
+    }
+    return 1;
+}
+
+int main(void)
+{
+    struct packed_seq *packed = create_packed_seq(0);
+    struct packed_seq *other = create_packed_seq(0);
+    int ok = 1;
+
+    if (encode_sequence(seq, 0, packed) != -1){
+        printf("Test failed: an empty sequence was packed\n");
+        ok = 0;
+    }
+    seed_random(1);
+    for (int len = 1; len <= MAX_LEN && ok; len++){
+        random_bases(seq, len);
+        if (encode_sequence(seq, len, packed) != 0){
+            printf("Test failed: %.*s was not packed\n", len, seq);
+            ok = 0;
+            break;
+        }
+        ok = check_decode(packed, len) && check_difference(packed, other, len)
+            && check_invalid(packed, len)
+            && check_complement(packed, other, len);
+    }
+    free_packed_seq(packed);
+    free_packed_seq(other);
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
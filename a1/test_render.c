@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#include "seqbot_render.h"
+#include "seqbot_bin.h"
+#include "test_util.h"
+
+/* Check every instruction rendering kernel this CPU supports on where runs
+ * begin and end. The vector kernels take the first base alone and then
+ * find the runs that begin in each block of 16 or 32 by comparing it with
+ * itself shifted back one base, so the cases are:
+ *   - two runs, with the boundary at every position, against text built
+ *     here from the two run lengths
+ *   - bases that alternate, so that a run begins at every position
+ *   - random runs with a mean length of 2, 8 and 64, in both formats
+ *     against render_scalar, and again with an invalid byte on either side
+ *     of each boundary and at both ends
+ * Then check that render_invalid prints what print_instructions always has
+ * for some invalid sequences. Prints "Test passed" or the first mismatch.
+ */
+
+// enough for eight AVX2 blocks after the first base and the longest tail
+#define MAX_LEN (1 + 8 * 32 + 31)
+
+static char seq[MAX_LEN];
+static struct out_buf expected;
+static struct out_buf actual;
+
+/* Compare kernel against render_scalar on the first length bytes of seq,
+ * rendering in format.
+ * Both start from a buffer that already holds some output, which must be
+ * kept. Return 1 if they agree.
+ */
+static int check_format(const char *name, render_fn kernel, int length,
+                        enum output_format format)
+{
+    int want;
+    int got;
+
+    expected.len = 0;
+    append_out_buf(&expected, "prefix\n", 7);
+    actual.len = 0;
+    append_out_buf(&actual, "prefix\n", 7);
+    want = render_scalar(&expected, seq, length, format);
+    got = kernel(&actual, seq, length, format);
+    if (got != want || actual.len != expected.len
+        || memcmp(actual.data, expected.data, actual.len) != 0){
+        printf("Test failed: %s returned %d, scalar returned %d for %.*s (%s)\n",
+               name, got, want, length, seq, format == FORMAT_BIN ? "bin" : "text");
+        return 0;
+    }
+    return 1;
+}
+
+/* Compare kernel against render_scalar in both formats.
+ * Return 1 if they agree.
+ */
+static int check(const char *name, render_fn kernel, int length)
+{
+    return check_format(name, kernel, length, FORMAT_TEXT)
+        && check_format(name, kernel, length, FORMAT_BIN);
+}
+
+/* Fill seq with first run copies of first and then second up to length,
+ * render it with kernel and compare with the text it must give.
+ * Return 1 if they agree.
+ */
+static int check_two_runs(const char *name, render_fn kernel, int length,
+                          int run, char first, char second)
+{
+    char text[128];
+    int n;
+    int temperature = 0;
+
+    for (int i = 0; i < length; i++){
+        seq[i] = i < run ? first : second;
+        temperature += seq[i] == 'C' || seq[i] == 'G' ? 4 : 2;
+    }
+    n = sprintf(text, "START\n");
+    if (run > 0){
+        n += sprintf(text + n, "WRITE %c %d\n", first, run);
+    }
+    if (run < length){
+        n += sprintf(text + n, "WRITE %c %d\n", second, length - run);
+    }
+    n += sprintf(text + n, "SET_TEMPERATURE %d\nEND\n", temperature);
+    actual.len = 0;
+    if (kernel(&actual, seq, length, FORMAT_TEXT) != temperature
+        || actual.len != n || memcmp(actual.data, text, n) != 0){
+        printf("Test failed: %s gave \"%.*s\" for %.*s\n",
+               name, (int)actual.len, actual.data, length, seq);
+        return 0;
+    }
+    return 1;
+}
+
+/* An invalid sequence and the text render_invalid must append for it.
+ */
+struct invalid_case {
+    const char *sequence;
+    const char *text;
+};
+
+static const struct invalid_case invalid_cases[] = {
+    {"", "START\nINVALID SEQUENCE\n"},
+    {"AAXC", "START\nINVALID SEQUENCE\n"},
+    {"AACXG", "START\nWRITE A 2\nINVALID SEQUENCE\n"},
+    {"ACGTTN", "START\nWRITE A 1\nWRITE C 1\nWRITE G 1\nINVALID SEQUENCE\n"},
+    {"AXGX", "START\nINVALID SEQUENCE\n"},
+    // the first base is not checked
+    {"X", "START\nWRITE X 1\nSET_TEMPERATURE -1\nEND\n"},
+    {"aaCG", "START\nINVALID SEQUENCE\n"},
+    {"aCCG", "START\nWRITE a 1\nWRITE C 2\nWRITE G 1\nSET_TEMPERATURE -1\nEND\n"},
+    {"XAXC", "START\nWRITE X 1\nINVALID SEQUENCE\n"}
+};
+
+/* Check render_invalid against invalid_cases, after some output that must
+ * be kept, in text and in binary. Return 1 if every case matches.
+ */
+static int check_invalid(void)
+{
+    const struct invalid_case *c;
+    const char bin[] = {BIN_START, BIN_INVALID};
+    size_t n = sizeof(invalid_cases) / sizeof(invalid_cases[0]);
+
+    for (size_t i = 0; i < n; i++){
+        c = &invalid_cases[i];
+        actual.len = 0;
+        append_out_buf(&actual, "prefix\n", 7);
+        render_invalid(&actual, c->sequence, strlen(c->sequence), FORMAT_TEXT);
+        if (actual.len != 7 + strlen(c->text)
+            || memcmp(actual.data + 7, c->text, strlen(c->text)) != 0){
+            printf("Test failed: render_invalid of \"%s\" gave \"%.*s\"\n",
+                   c->sequence, (int)actual.len - 7, actual.data + 7);
+            return 0;
+        }
+        actual.len = 0;
+        render_invalid(&actual, c->sequence, strlen(c->sequence), FORMAT_BIN);
+        if (actual.len != sizeof(bin) || memcmp(actual.data, bin, sizeof(bin)) != 0){
+            printf("Test failed: binary render_invalid of \"%s\"\n", c->sequence);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Check kernel on random runs of length bases, with a new run starting
+ * with chance 1/spread, then with an invalid byte at each end and on
+ * either side of each run boundary. Return 1 if it passes.
+ */
+static int check_random_runs(const char *name, render_fn kernel, int length,
+                             int spread)
+{
+    int ok;
+
+    random_runs(seq, length, spread);
+    ok = check(name, kernel, length);
+    for (int pos = 0; pos < length && ok; pos++){
+        int boundary = pos > 0 && seq[pos] != seq[pos - 1];
+        int before = pos + 1 < length && seq[pos + 1] != seq[pos];
+        if (pos != 0 && pos != length - 1 && !boundary && !before){
+            continue;
+        }
+        char saved = seq[pos];
+        seq[pos] = bad_byte(pos);
+        ok = check(name, kernel, length);
+        seq[pos] = saved;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    const char *bases = "ACGT";
+    render_fn kernels[4];
+    const char *names[4];
+    int num_kernels = 0;
+    int ok = 1;
+
+    names[num_kernels] = "scalar";
+    kernels[num_kernels++] = render_scalar;
+    names[num_kernels] = "dispatch";
+    kernels[num_kernels++] = render_instructions;
+#ifdef SEQBOT_X86
+    if (cpu_has_sse2()){
+        names[num_kernels] = "sse2";
+        kernels[num_kernels++] = render_sse2;
+    }
+    if (cpu_has_avx2()){
+        names[num_kernels] = "avx2";
+        kernels[num_kernels++] = render_avx2;
+    }
+#endif
+
+    init_out_buf(&expected);
+    init_out_buf(&actual);
+    seed_random(8);
+    for (int len = 0; len <= MAX_LEN && ok; len++){
+        for (int k = 0; k < num_kernels && ok; k++){
+            // every pair of different bases, and one run when run is 0
+            for (int run = 0; run < len && ok; run++){
+                ok = check_two_runs(names[k], kernels[k], len, run,
+                                    bases[run % 4], bases[(run + 1 + run / 4 % 3) % 4]);
+            }
+            for (int i = 0; i < len; i++){
+                seq[i] = bases[i % 2 * 3];
+            }
+            if (ok){
+                ok = check(names[k], kernels[k], len);
+            }
+            for (int spread = 2; spread <= 64 && ok; spread *= 8){
+                ok = check_random_runs(names[k], kernels[k], len, spread);
+            }
+        }
+    }
+    if (ok){
+        ok = check_invalid();
+    }
+    free_out_buf(&expected);
+    free_out_buf(&actual);
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
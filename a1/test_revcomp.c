@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+#include "seqbot_revcomp.h"
+#include "test_util.h"
+
+/* Check every sequence transform kernel this CPU supports against a plain
+ * reverse and complement done here, for every mode. The reversing modes
+ * swap a block of 16 from each end until fewer than 32 bases are left and
+ * finish the middle two at a time, with one base left over for odd
+ * lengths, so the cases are:
+ *   - random sequences of every length, odd and even, up to MAX_LEN
+ *   - palindromes, which mode 2 leaves alone, and sequences that are
+ *     their own reverse complement, which mode 3 leaves alone
+ *   - every mode done twice, which must give the sequence back
+ *   - an invalid byte at either end, in the middle or at the edge of a
+ *     block counted from either end, which must still be invalid after
+ * Prints "Test passed" or the first mismatch found.
+ */
+
+// enough for six pairs of blocks and the longest middle
+#define MAX_LEN (6 * 32 + 31)
+
+static char original[MAX_LEN];
+static char expected[MAX_LEN];
+static char actual[MAX_LEN];
+
+static char complement(char c)
+{
+    return c == 'A' ? 'T' : c == 'T' ? 'A' : c == 'C' ? 'G' : 'C';
+}
+
+/* Fill expected with the first length bases of original transformed by mode.
+ */
+static void reference(int length, int mode)
+{
+    char c;
+    for (int i = 0; i < length; i++){
+        c = original[mode >= 2 ? length - 1 - i : i];
+        expected[i] = mode % 2 == 1 ? complement(c) : c;
+    }
+}
+
+/* Run kernel on a copy of original and compare it with expected, then run
+ * it again and compare with original. Return 1 if both agree.
+ */
+static int check(const char *name, transform_fn kernel, int length, int mode)
+{
+    memcpy(actual, original, length);
+    kernel(actual, length, mode);
+    if (memcmp(actual, expected, length) != 0){
+        printf("Test failed: %s gave %.*s for %.*s (mode %d)\n",
+               name, length, actual, length, original, mode);
+        return 0;
+    }
+    kernel(actual, length, mode);
+    if (memcmp(actual, original, length) != 0){
+        printf("Test failed: %s twice gave %.*s for %.*s (mode %d)\n",
+               name, length, actual, length, original, mode);
+        return 0;
+    }
+    return 1;
+}
+
+/* Run kernel on a copy of original with an invalid byte at pos and check
+ * that some byte of the result is still not a base. Return 1 if it is.
+ */
+static int check_invalid(const char *name, transform_fn kernel, int length,
+                         int mode, int pos)
+{
+    memcpy(actual, original, length);
+    actual[pos] = bad_byte(pos);
+    kernel(actual, length, mode);
+    for (int i = 0; i < length; i++){
+        if (!is_base(actual[i])){
+            return 1;
+        }
+    }
+    printf("Test failed: %s made %.*s valid (mode %d)\n", name, length, actual, mode);
+    return 0;
+}
+
+/* Return 1 if pos is at an end, in the middle, or at the edge of a block
+ * counted from either end of a sequence of length bases.
+ */
+static int edge(int pos, int length)
+{
+    int back = length - 1 - pos;
+    return pos == length / 2 || pos == (length - 1) / 2
+        || pos % 16 == 0 || pos % 16 == 15 || back % 16 == 0 || back % 16 == 15;
+}
+
+/* Check kernel on original in every mode, with invalid bytes as well
+ * if invalid is set. Return 1 if it passes.
+ */
+static int check_modes(const char *name, transform_fn kernel, int length, int invalid)
+{
+    int ok = 1;
+    for (int mode = 0; mode < 4 && ok; mode++){
+        reference(length, mode);
+        ok = check(name, kernel, length, mode);
+        for (int pos = 0; pos < length && ok && invalid; pos++){
+            if (edge(pos, length)){
+                ok = check_invalid(name, kernel, length, mode, pos);
+            }
+        }
+    }
+    return ok;
+}
+
+int main(void)
+{
+    transform_fn kernels[3];
+    const char *names[3];
+    int num_kernels = 0;
+    int ok = 1;
+
+    names[num_kernels] = "dispatch";
+    kernels[num_kernels++] = transform_sequence;
+    names[num_kernels] = "scalar";
+    kernels[num_kernels++] = transform_scalar;
+#ifdef SEQBOT_X86
+    if (cpu_has_ssse3()){
+        names[num_kernels] = "ssse3";
+        kernels[num_kernels++] = transform_ssse3;
+    }
+#endif
+
+    seed_random(7);
+    for (int len = 0; len <= MAX_LEN && ok; len++){
+        for (int k = 0; k < num_kernels && ok; k++){
+            random_bases(original, len);
+            ok = check_modes(names[k], kernels[k], len, 1);
+
+            // a palindrome, with a middle base of its own for odd lengths
+            for (int i = 0; i < len / 2; i++){
+                original[len - 1 - i] = original[i];
+            }
+            reference(len, 2);
+            if (ok && memcmp(expected, original, len) != 0){
+                printf("Test failed: %.*s is not a palindrome\n", len, original);
+                ok = 0;
+            }
+            if (ok){
+                ok = check_modes(names[k], kernels[k], len, 0);
+            }
+
+            // its own reverse complement, which needs an even length
+            if (len % 2 == 0){
+                for (int i = 0; i < len / 2; i++){
+                    original[len - 1 - i] = complement(original[i]);
+                }
+                reference(len, 3);
+                if (ok && memcmp(expected, original, len) != 0){
+                    printf("Test failed: %.*s is not its own reverse complement\n",
+                           len, original);
+                    ok = 0;
+                }
+                if (ok){
+                    ok = check_modes(names[k], kernels[k], len, 0);
+                }
+            }
+        }
+    }
+    if (ok){
+        printf("Test passed\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#include <stdlib.h>
+#include "test_util.h"
+
+static const char bases[] = "ACGT";
+
+static const char bad_bytes[] = {'a', 'c', 'g', 't', 'N', 'X', 'q', '\0', '\n', (char)0xC1};
+
+void seed_random(unsigned seed)
+{
+    srand(seed);
+}
+
+void random_bases(char *sequence, int length)
+{
+    for (int i = 0; i < length; i++){
+        sequence[i] = bases[rand() % 4];
+    }
+}
+
+void random_runs(char *sequence, int length, int spread)
+{
+    for (int i = 0; i < length; i++){
+        if (i > 0 && rand() % spread != 0){
+            sequence[i] = sequence[i - 1];
+        } else {
+            sequence[i] = bases[rand() % 4];
+        }
+    }
+}
+
+char bad_byte(int i)
+{
+    return bad_bytes[i % sizeof(bad_bytes)];
+}
+
+int is_base(char c)
+{
+    return c == 'A' || c == 'C' || c == 'G' || c == 'T';
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_UTIL
+#define TEST_UTIL
+
+/* Sequence generators shared by the kernel tests. Each test seeds them
+ * with its own number so that a failure can be reproduced.
+ */
+
+void seed_random(unsigned seed);
+
+// fill sequence with length bases picked uniformly from A, C, G and T
+void random_bases(char *sequence, int length);
+
+// fill sequence with runs of bases, starting a new run with chance 1/spread
+void random_runs(char *sequence, int length, int spread);
+
+/* The i-th of the bytes that are never a base: lowercase bases, other
+ * letters, NUL, a newline and a byte with the top bit set. Any i is
+ * allowed; they repeat.
+ */
+char bad_byte(int i);
+
+// 1 if c is one of 'A', 'C', 'G', 'T'
+int is_base(char c);
+
+#endif
@@ -6,26 +6,28 @@
 #include "constraints.h"
 
 /* Create and initialize a constraints struct. 
- * Sets the fields to 0 or empty string.
+ * Sets the masks to 0 and the strings to the empty string.
  * Return a pointer to the newly created constraints struct.
  */
 struct constraints *init_constraints() {
     struct constraints *ret;
     ret = malloc(sizeof(struct constraints));
+    if (ret == NULL){
+        perror("malloc");
+        exit(1);
+    }
     int i;
-    // set must_be to '\0'
+    // set must_be to the empty set
     for (i = 0; i < WORDLEN; i++){
-        ret->must_be[i][0] = '\0';
-    }
-    // set each char of cannot_be to '0'
-    for (i = 0; i < ALPHABET_SIZE; i++){
-        ret->cannot_be[i] = '0';
+        ret->must_be[i] = 0;
+        ret->must_be_letters[i][0] = '\0';
     }
+    ret->cannot_be = 0;
     return ret;
 }
 
-/* Update the "must_be" field at "index" to be a string 
- * containing "letter"
+/* Update the "must_be" field at "index" to be the set
+ * containing only "letter"
  * The tile at this index is green, therefore the letter at "index"
  * must be "letter"
  */
@@ -33,12 +35,13 @@ void set_green(char letter, int index, struct constraints *con) {
     assert(islower(letter));
     assert(index >= 0 && index < SIZE);
 
-    con->must_be[index][0] = letter;
-    con->must_be[index][1] = '\0';
+    con->must_be[index] = LETTER_BIT(letter);
+    con->must_be_letters[index][0] = letter;
+    con->must_be_letters[index][1] = '\0';
     return;
 }
 
-/* Update "con" by adding the possible letters to the string at the must_be 
+/* Update "con" by adding the possible letters to the set at the must_be 
  * field for "index".
  * - index is the index of the yellow tile in the current row to be updated
  * - cur_tiles is the tiles of this row
@@ -62,23 +65,26 @@ void set_yellow(int index, char *cur_tiles, char *next_tiles,
     int i;
     int must_be_index = 0;
 
+    con->must_be[index] = 0;
     // if target tile is green, then it has to be the same letter in the next word
     if (cur_tiles[index] == 'g'){
-        con->must_be[index][0] = word[index];
-        con->must_be[index][1] = '\0';
+        con->must_be[index] = LETTER_BIT(word[index]);
+        con->must_be_letters[index][0] = word[index];
+        must_be_index = 1;
     }
     // if target tile is yellow
     else if (cur_tiles[index] == 'y'){
         for (i = 0; i < WORDLEN; i++){
             // we take all the letters that are green or yellow in the next tile with that index in cur tile not green
             if (i != index && next_tiles[i] != '-' && cur_tiles[i] != 'g'){
-                con->must_be[index][must_be_index] = word[i];
+                con->must_be[index] |= LETTER_BIT(word[i]);
+                con->must_be_letters[index][must_be_index] = word[i];
                 must_be_index += 1;
             }
         }
     }
     // terminate the word
-    con->must_be[index][must_be_index] = '\0';
+    con->must_be_letters[index][must_be_index] = '\0';
     return;
 }
 
@@ -88,9 +94,9 @@ void set_yellow(int index, char *cur_tiles, char *next_tiles,
 void add_to_cannot_be(char *cur_word, struct constraints *con) {
     assert(strlen(cur_word) <= WORDLEN);
     int i;
-    // traverse the array
-    for (i = 0; i < strlen(cur_word); i++){
-        con->cannot_be[cur_word[i] - 'a'] = '1';
+    // traverse the word
+    for (i = 0; cur_word[i] != '\0'; i++){
+        con->cannot_be |= LETTER_BIT(cur_word[i]);
     }
     return;
 }
@@ -101,7 +107,7 @@ void print_constraints(struct constraints *c) {
     char curr_char;
     // traverse the cannot be array
     for (int i = 0; i < ALPHABET_SIZE; i++){
-        if (c->cannot_be[i] == '1'){
+        if (c->cannot_be & LETTER_BIT('a' + i)){
             curr_char = 97 + i;
             printf("%c ", curr_char);
         }
@@ -113,11 +119,11 @@ void print_constraints(struct constraints *c) {
     for (int i = 0; i < WORDLEN; i++){
         printf("[%d] ", i);
         for (int j = 0; j < SIZE; j++){
-            if (c->must_be[i][j] == '\0'){
+            if (c->must_be_letters[i][j] == '\0'){
                 printf("\n");
                 break;
             }
-            printf("%c ", c->must_be[i][j]);
+            printf("%c ", c->must_be_letters[i][j]);
         }
     }
 }
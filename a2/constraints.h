@@ -1,25 +1,30 @@
+#include <stdint.h>
 #include "common.h"
+
+// the bit of a lower-case letter in a letter mask ('a' is bit 0)
+#define LETTER_BIT(letter) ((uint32_t)1 << ((letter) - 'a'))
+
 /* A data structure that holds a representation of the constraints
  * that will be used at a level of the grid.
- *   - must_be - a character array for each letter in the word that
+ *   - must_be - a letter mask for each letter in the word that
  *           species which letters from the solution word must be in
  *           this slot.  It is used for yellow and green boxes
- *            - if must_be[i] is the empty string, then the letters in 
+ *            - if must_be[i] is 0, then the letters in 
  *           this slot are limited by the letters that "cannot_be".  These
  *           are letters that apprear later in the solution path (earlier
  *           in the grid)  This is used for grey boxes.
- *   - cannot_be - a set of characters that cannot be in a grey box
- *     either because they are in the solution or they are in a word
- *     guessed in a row closer to the solution. 
- *     This set is represented as an array of 26 numbers.  If cannot_be[0] is 1
- *     then 'a' is in the set.  If cannot_be[1] is 0 then 'b' is not in the set.
- *     To add 'f' to the set, we can say "cannot_be['f'-'a'] = 1;"  We are  
- *     taking advantage of the fact that lower-case alphabet is stored as ascii 
- *     values in increasing order. ('f' - 'a' == 5)
+ *   - cannot_be - the letter mask of the characters that cannot be in a
+ *     grey box either because they are in the solution or they are in a
+ *     word guessed in a row closer to the solution.
+ *   - must_be_letters - the letters of must_be[i] as a string, in the order
+ *     they were added, which is the order print_constraints shows them in.
+ * A letter mask is a set of letters with LETTER_BIT(letter) set for each
+ * letter in the set, so checking a letter against a slot is one AND.
  */
 struct constraints {
-    char must_be[WORDLEN][SIZE];  // if must_be[i] is '' then use cannot_be
-    char cannot_be[ALPHABET_SIZE]; 
+    uint32_t must_be[WORDLEN];  // if must_be[i] is 0 then use cannot_be
+    uint32_t cannot_be;
+    char must_be_letters[WORDLEN][SIZE];
 };
 
 struct constraints *init_constraints();
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wordle.h"
+#include "constraints.h"
+#include "filter.h"
+
+#ifdef FILTER_X86
+#include <immintrin.h>
+#endif
+
+// the set of all of the letters
+#define ALL_LETTERS (LETTER_BIT('a' + ALPHABET_SIZE) - 1)
+
+/* Return the number of uint32_t in a bitmap of the words of dict
+ */
+int filter_bitmap_size(struct dictionary *dict) {
+    return (dict->num_words + 31) / 32;
+}
+
+/* Set masks to the letter sets that the words matching "con" for row
+ * "row" of "w" have to fit, following the rules of match_constraints:
+ *   - slot i allows must_be[i], or every letter outside cannot_be if
+ *     must_be[i] is empty
+ *   - a slot that is yellow in this row cannot hold the solution's letter
+ *     for that slot
+ */
+void set_filter_masks(struct constraints *con, struct wordle *w, int row,
+                      struct filter_masks *masks) {
+    masks->solution = 0;
+    for (int i = 0; i < WORDLEN; i++){
+        if (con->must_be[i] != 0){
+            masks->allowed[i] = con->must_be[i];
+        }
+        else {
+            masks->allowed[i] = ~con->cannot_be & ALL_LETTERS;
+        }
+        if (w->grid[row][i] == 'y'){
+            masks->allowed[i] &= ~LETTER_BIT(w->grid[0][i]);
+        }
+        masks->solution |= LETTER_BIT(w->grid[0][i]);
+    }
+}
+
+/* Scalar kernel: one word at a time, with the same mask tests as
+ * match_constraints.
+ */
+void filter_scalar(struct dictionary *dict, struct filter_masks *masks,
+                   uint32_t *matches) {
+    uint32_t bit;
+    uint32_t seen;
+    uint32_t repeated;
+    int ok;
+
+    memset(matches, 0, filter_bitmap_size(dict) * sizeof(*matches));
+    for (int d = 0; d < dict->num_words; d++){
+        seen = 0;
+        repeated = 0;
+        ok = 1;
+        for (int i = 0; i < WORDLEN; i++){
+            bit = (uint32_t)1 << dict->columns[i][d];
+            ok &= (masks->allowed[i] & bit) != 0;
+            repeated |= seen & bit;
+            seen |= bit;
+        }
+        if (ok && (repeated & masks->solution) == 0){
+            matches[d / 32] |= (uint32_t)1 << (d % 32);
+        }
+    }
+}
+
+#ifdef FILTER_X86
+
+/* Set lo and hi to the 16-byte lookup tables of the letter set "set" for
+ * the two halves of the alphabet: lo[j] is 0xFF if letter j is in the set,
+ * and hi[j] if letter 16 + j is. The letters after 'z' are never in it.
+ */
+static void letter_tables(uint32_t set, unsigned char *lo, unsigned char *hi) {
+    for (int j = 0; j < 16; j++){
+        lo[j] = (set >> j) & 1 ? 0xFF : 0;
+        hi[j] = (set >> (16 + j)) & 1 ? 0xFF : 0;
+    }
+}
+
+/* SSSE3 kernel: 16 words at a time.
+ * Slot i of 16 words is one load from column i. Whether each letter code c
+ * is in a set is looked up with two shuffles, one of the table of each
+ * half of the alphabet: c + 0x70 indexes the first half and has its high
+ * bit set, which makes the shuffle give 0, when c >= 16, and c - 16
+ * indexes the second half and is negative when c < 16. A repeated letter
+ * is found by comparing every pair of slots.
+ * The columns are padded to COLUMN_BLOCK words, so every load is whole, and
+ * the padding never matches since no set holds COLUMN_PADDING.
+ */
+__attribute__((target("ssse3")))
+void filter_ssse3(struct dictionary *dict, struct filter_masks *masks,
+                  uint32_t *matches) {
+    unsigned char lo[16];
+    unsigned char hi[16];
+    const __m128i first_offset = _mm_set1_epi8(0x70);
+    const __m128i second_offset = _mm_set1_epi8(16);
+    __m128i allowed_lo[WORDLEN];
+    __m128i allowed_hi[WORDLEN];
+    __m128i solution_lo;
+    __m128i solution_hi;
+    __m128i letters[WORDLEN];
+    __m128i first_half;
+    __m128i second_half;
+    __m128i ok;
+    __m128i repeated;
+    __m128i in_solution;
+    int d;
+    int i;
+    int j;
+
+    for (i = 0; i < WORDLEN; i++){
+        letter_tables(masks->allowed[i], lo, hi);
+        allowed_lo[i] = _mm_loadu_si128((__m128i *)lo);
+        allowed_hi[i] = _mm_loadu_si128((__m128i *)hi);
+    }
+    letter_tables(masks->solution, lo, hi);
+    solution_lo = _mm_loadu_si128((__m128i *)lo);
+    solution_hi = _mm_loadu_si128((__m128i *)hi);
+
+    memset(matches, 0, filter_bitmap_size(dict) * sizeof(*matches));
+    for (d = 0; d < dict->num_words; d += 16){
+        ok = _mm_set1_epi8(-1);
+        repeated = _mm_setzero_si128();
+        for (i = 0; i < WORDLEN; i++){
+            letters[i] = _mm_loadu_si128((__m128i *)(dict->columns[i] + d));
+            first_half = _mm_add_epi8(letters[i], first_offset);
+            second_half = _mm_sub_epi8(letters[i], second_offset);
+            ok = _mm_and_si128(ok, _mm_or_si128(_mm_shuffle_epi8(allowed_lo[i], first_half),
+                                                _mm_shuffle_epi8(allowed_hi[i], second_half)));
+            in_solution = _mm_or_si128(_mm_shuffle_epi8(solution_lo, first_half),
+                                       _mm_shuffle_epi8(solution_hi, second_half));
+            for (j = 0; j < i; j++){
+                repeated = _mm_or_si128(repeated,
+                                        _mm_and_si128(in_solution,
+                                                      _mm_cmpeq_epi8(letters[i], letters[j])));
+            }
+        }
+        ok = _mm_andnot_si128(repeated, ok);
+        matches[d / 32] |= (uint32_t)_mm_movemask_epi8(ok) << (d % 32);
+    }
+}
+
+/* AVX2 kernel: 32 words at a time, as filter_ssse3 does 16. The shuffles
+ * look up within each 128-bit lane, so both lanes get the same tables.
+ */
+__attribute__((target("avx2")))
+void filter_avx2(struct dictionary *dict, struct filter_masks *masks,
+                 uint32_t *matches) {
+    unsigned char lo[16];
+    unsigned char hi[16];
+    const __m256i first_offset = _mm256_set1_epi8(0x70);
+    const __m256i second_offset = _mm256_set1_epi8(16);
+    __m256i allowed_lo[WORDLEN];
+    __m256i allowed_hi[WORDLEN];
+    __m256i solution_lo;
+    __m256i solution_hi;
+    __m256i letters[WORDLEN];
+    __m256i first_half;
+    __m256i second_half;
+    __m256i ok;
+    __m256i repeated;
+    __m256i in_solution;
+    int d;
+    int i;
+    int j;
+
+    for (i = 0; i < WORDLEN; i++){
+        letter_tables(masks->allowed[i], lo, hi);
+        allowed_lo[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)lo));
+        allowed_hi[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)hi));
+    }
+    letter_tables(masks->solution, lo, hi);
+    solution_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)lo));
+    solution_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)hi));
+
+    for (d = 0; d < dict->num_words; d += 32){
+        ok = _mm256_set1_epi8(-1);
+        repeated = _mm256_setzero_si256();
+        for (i = 0; i < WORDLEN; i++){
+            letters[i] = _mm256_loadu_si256((__m256i *)(dict->columns[i] + d));
+            first_half = _mm256_add_epi8(letters[i], first_offset);
+            second_half = _mm256_sub_epi8(letters[i], second_offset);
+            ok = _mm256_and_si256(ok, _mm256_or_si256(_mm256_shuffle_epi8(allowed_lo[i], first_half),
+                                                      _mm256_shuffle_epi8(allowed_hi[i], second_half)));
+            in_solution = _mm256_or_si256(_mm256_shuffle_epi8(solution_lo, first_half),
+                                          _mm256_shuffle_epi8(solution_hi, second_half));
+            for (j = 0; j < i; j++){
+                repeated = _mm256_or_si256(repeated,
+                                           _mm256_and_si256(in_solution,
+                                                            _mm256_cmpeq_epi8(letters[i], letters[j])));
+            }
+        }
+        ok = _mm256_andnot_si256(repeated, ok);
+        matches[d / 32] = (uint32_t)_mm256_movemask_epi8(ok);
+    }
+}
+
+#endif
+
+/* Return the fastest kernel this CPU supports
+ */
+static filter_fn pick_filter(void) {
+#ifdef FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")){
+        return filter_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")){
+        return filter_ssse3;
+    }
+#endif
+    return filter_scalar;
+}
+
+/* Set the bitmap "matches" to the words of dict that match "con" for row
+ * "row" of "w", using the fastest kernel. The kernel is picked on the
+ * first call.
+ */
+void filter_dictionary(struct dictionary *dict, struct constraints *con,
+                       struct wordle *w, int row, uint32_t *matches) {
+    static filter_fn filter_kernel = NULL;
+    struct filter_masks masks;
+
+    if (filter_kernel == NULL){
+        filter_kernel = pick_filter();
+    }
+    set_filter_masks(con, w, row, &masks);
+    filter_kernel(dict, &masks, matches);
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include "common.h"
+
+struct dictionary;
+struct constraints;
+struct wordle;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FILTER_X86
+#endif
+
+/* Filter the whole dictionary against the constraints of a row at once,
+ * using the columns of the dictionary.
+ *
+ * The result is a bitmap with one bit per word: bit k of matches[j] is 1
+ * if word 32 * j + k matches, as match_constraints would return for it.
+ * It takes filter_bitmap_size(dict) uint32_t, and the bits after the last
+ * word are 0.
+ *
+ * A row's constraints come down to two sets of masks that a kernel checks
+ * each word against:
+ *   - allowed[i] is the set of letters that slot i can hold
+ *   - solution is the set of letters in the solution, which a word may
+ *     not have twice
+ */
+struct filter_masks {
+    uint32_t allowed[WORDLEN];
+    uint32_t solution;
+};
+
+typedef void (*filter_fn)(struct dictionary *dict, struct filter_masks *masks,
+                          uint32_t *matches);
+
+void filter_scalar(struct dictionary *dict, struct filter_masks *masks,
+                   uint32_t *matches);
+
+#ifdef FILTER_X86
+void filter_ssse3(struct dictionary *dict, struct filter_masks *masks,
+                  uint32_t *matches);
+void filter_avx2(struct dictionary *dict, struct filter_masks *masks,
+                 uint32_t *matches);
+#endif
+
+int filter_bitmap_size(struct dictionary *dict);
+void set_filter_masks(struct constraints *con, struct wordle *w, int row,
+                      struct filter_masks *masks);
+void filter_dictionary(struct dictionary *dict, struct constraints *con,
+                       struct wordle *w, int row, uint32_t *matches);
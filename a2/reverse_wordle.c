@@ -3,6 +3,7 @@
 #include <string.h>
 #include "wordle.h"
 #include "constraints.h"
+#include "filter.h"
 
 /* Read the wordle grid and solution from fp. 
  * Return a pointer to a wordle struct.
@@ -39,15 +40,9 @@ struct wordle *create_wordle(FILE *fp) {
  */
 struct solver_node *create_solver_node(struct constraints *con, char *word) {
     struct solver_node *ret = malloc(sizeof(*ret));
-    int i;
     if (con != NULL){
         struct constraints *new_con = init_constraints();
-        for (i = 0; i < ALPHABET_SIZE; i++){
-            new_con->cannot_be[i] = con->cannot_be[i];
-        }
-        for (i = 0; i < WORDLEN; i++){
-            strcpy(new_con->must_be[i], con->must_be[i]);
-        }
+        *new_con = *con;
         ret->con = new_con;
     }
     else {
@@ -62,64 +57,41 @@ struct solver_node *create_solver_node(struct constraints *con, char *word) {
 
 /* Return 1 if "word" matches the constraints in "con" for the wordle "w".
  * Return 0 if it does not match
+ * Each slot is checked with one AND against the mask of letters it allows.
  */
 int match_constraints(char *word, struct constraints *con, 
 struct wordle *w, int row) {
     int i;
-    int j;
-    char curr_letter;
-    char comp_letter;
-    int have_letter;
-    if (strlen(word) != 5){
+    uint32_t bit;
+    uint32_t seen = 0;
+    uint32_t repeated = 0;
+    uint32_t solution = 0;
+    if (strlen(word) != WORDLEN){
         return 0;
     }
     
     for (i = 0; i < WORDLEN; i++){
-        curr_letter = word[i];
-
-        // disqualify the word if the letter is not in the must be list
-        if (con->must_be[i][0] != '\0'){
-            have_letter = 0;
-            for (j = 0; j < strlen(con->must_be[i]); j++){
-                if (curr_letter == con->must_be[i][j]){
-                    have_letter = 1;
-                }
-            }
-            if (have_letter == 0){
-                return 0;
-            }
-        }
+        bit = LETTER_BIT(word[i]);
 
-        // must_be[i] is empty, we look into the cannot be list
-        else {
-            // disqualify the word if the letter is in the cannot be list
-            for (j = 0; j < ALPHABET_SIZE; j++){
-                if (con->cannot_be[j] == '1'){
-                    comp_letter = j+97;
-                    if (comp_letter == curr_letter){
-                        return 0;
-                    }
-                }
-            }
+        // disqualify the word if the letter is not in the must be set,
+        // or if must_be[i] is empty and the letter is in the cannot be set
+        if (con->must_be[i] != 0 ? (con->must_be[i] & bit) == 0
+                                 : (con->cannot_be & bit) != 0){
+            return 0;
         }
 
         // rule out the possibility that a yellow letter could be at correct position as a green letter
         if (word[i] == w->grid[0][i] && w->grid[row][i] == 'y'){
             return 0;
         }
+        repeated |= seen & bit;
+        seen |= bit;
+        solution |= LETTER_BIT(w->grid[0][i]);
     }
     
     // rule out the words with duplicated solution letters
-    for (i = 0; i < WORDLEN; i++){
-        for (j = i + 1; j < WORDLEN; j++){
-            if (word[i] == word[j]){
-                for (int k = 0; k < WORDLEN; k++){
-                    if (w->grid[0][k] == word[i]){
-                        return 0;
-                    }
-                }
-            }
-        }
+    if (repeated & solution){
+        return 0;
     }
 
     // otherwise it is qualified
@@ -136,24 +108,57 @@ void remove_char(char *word, char letter) {
     }
 }
 
+/* Update "con" with the constraints that "word" in row "row" - 1 of the
+ * wordle "w" puts on the word guessed in row "row".
+ * The solution word's row has no tiles in the grid, so for row 1 the row
+ * before it is taken to be all green.
+ */
+void set_row_constraints(int row, struct wordle *w, char *word,
+                         struct constraints *con) {
+    char all_g[SIZE];
+    int i;
+
+    // this is for the solution word's pseudo grid
+    for (i = 0; i < WORDLEN; i++){
+        all_g[i] = 'g';
+    }
+    all_g[WORDLEN] = '\0';
+
+    for (i = 0; i < WORDLEN; i++){
+        if (w->grid[row][i] == 'g'){
+            set_green(word[i], i, con);
+        }
+        else if (w->grid[row][i] == 'y'){
+            if (row == 1){
+                // we consider the grid for solution word as an all green sequence
+                set_yellow(i, w->grid[row], all_g, word, con);
+            }
+            else {
+                set_yellow(i, w->grid[row], w->grid[row - 1], word, con);
+            }
+        }
+    }
+    add_to_cannot_be(word, con);
+}
+
 /* Build a tree starting at "row" in the wordle "w". 
  * Use the "parent" constraints to set up the constraints for this node
  * of the tree
- * For each word in "dict", 
- *    - if a word matches the constraints, then 
+ * Filter "dict" against the constraints all at once, then for each
+ * matching word in the order of "dict", 
  *        - create a copy of the constraints for the child node and update
  *          the constraints with the new information.
  *        - add the word to the child_list of the current solver node
  *        - call solve_subtree on newly created subtree
  */
 
-void solve_subtree(int row, struct wordle *w,  struct node *dict, 
+void solve_subtree(int row, struct wordle *w,  struct dictionary *dict, 
                    struct solver_node *parent) {
     struct solver_node *new_node;
     struct solver_node *prev_node = NULL;
     struct solver_node *first_node = NULL;
-    int i;
-    char all_g[SIZE];
+    uint32_t *matches;
+    uint32_t bits;
 
     if(verbose) {
         printf("Running solve_subtree: %d, %s\n", row, parent->word);
@@ -167,41 +172,28 @@ void solve_subtree(int row, struct wordle *w,  struct node *dict,
     if (row == 1){
         // the root node cannot have siblings
         parent->next_sibling = NULL;
-        // this is for the solution word's pseudo grid
-        for (int j = 0; j < WORDLEN; j++){
-            all_g[j] = 'g';
-        }
-        all_g[WORDLEN] = '\0';
     }
 
     // setup constrains
-    for (i = 0; i < WORDLEN; i++){
-        if (w->grid[row][i] == 'g'){
-            set_green(parent->word[i], i, parent->con);
-        }
-        else if (w->grid[row][i] == 'y'){
-            if (row == 1){
-                // we consider the grid for solution word as an all green sequence
-                set_yellow(i, w->grid[row], all_g, parent->word, parent->con);
-            }
-            else {
-                set_yellow(i, w->grid[row], w->grid[row - 1], parent->word, parent->con);
-            }
-        }
+    set_row_constraints(row, w, parent->word, parent->con);
+
+    // find every valid guess in one pass over the dictionary
+    matches = malloc(filter_bitmap_size(dict) * sizeof(*matches));
+    if (matches == NULL){
+        perror("malloc");
+        exit(1);
     }
-    add_to_cannot_be(parent->word, parent->con);
-    
-    struct node *ptr = dict;
-    while (ptr != NULL){
-        // if we find a valid guess, then we add a new node for it
-        if (match_constraints(ptr->word, parent->con, w, row) == 1){
-            
+    filter_dictionary(dict, parent->con, w, row, matches);
+
+    for (int j = 0; j < filter_bitmap_size(dict); j++){
+        for (bits = matches[j]; bits != 0; bits &= bits - 1){
+            char *word = dict_word(dict, 32 * j + __builtin_ctz(bits));
+
+            // we found a valid guess, so we add a new node for it
             // setup word and init new constrains
-            new_node = create_solver_node(NULL, ptr->word);
+            new_node = create_solver_node(NULL, word);
             new_node->con = init_constraints();
-            for (i = 0; i < ALPHABET_SIZE; i++){
-                new_node->con->cannot_be[i] = parent->con->cannot_be[i];
-            }
+            new_node->con->cannot_be = parent->con->cannot_be;
             new_node->child_list = NULL;
             new_node->next_sibling = NULL;
 
@@ -225,9 +217,8 @@ void solve_subtree(int row, struct wordle *w,  struct node *dict,
                 prev_node = new_node;
             }
         }
-        // go for next word
-        ptr = ptr->next;
     }
+    free(matches);
 }
 
 /* Print to standard output all paths that are num_rows in length.
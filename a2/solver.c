@@ -37,7 +37,7 @@ int main(int argc, char **argv) {
     }
 
     // 1. Get the list of words
-    struct node *dict = read_list(DICT_FILE);
+    struct dictionary *dict = read_list(DICT_FILE);
 
     // 2. Read in the wordle input
     struct wordle *w = create_wordle(fp);
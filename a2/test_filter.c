@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wordle.h"
+#include "constraints.h"
+#include "filter.h"
+
+/* Check that every filter kernel picks out the same words of the
+ * dictionary as match_constraints, for the constraints that the solver
+ * builds for a wordle input file.
+ *
+ * The tree of constraints is walked as solve_subtree builds it, but only
+ * through the first BRANCHES matching words of each node so that the test
+ * stays quick. Every row of tiles in the grid is checked.
+ */
+
+// the number of children of each node that the walk goes into
+#define BRANCHES 4
+
+int verbose = 0;
+
+struct kernel {
+    char *name;
+    filter_fn filter;
+};
+
+static struct kernel kernels[3];
+static int num_kernels = 0;
+static int num_checks = 0;
+
+/* Return 1 if each kernel agrees with match_constraints on every word of
+ * dict for "con" in row "row" of "w", and 0 otherwise.
+ */
+static int check_filters(struct dictionary *dict, struct constraints *con,
+                         struct wordle *w, int row) {
+    struct filter_masks masks;
+    uint32_t *matches = malloc(filter_bitmap_size(dict) * sizeof(*matches));
+    int expected;
+    int got;
+    int ret = 1;
+
+    if (matches == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    set_filter_masks(con, w, row, &masks);
+    for (int k = 0; k < num_kernels; k++){
+        kernels[k].filter(dict, &masks, matches);
+        for (int d = 0; d < filter_bitmap_size(dict) * 32; d++){
+            got = (matches[d / 32] >> (d % 32)) & 1;
+            expected = d < dict_size(dict) &&
+                       match_constraints(dict_word(dict, d), con, w, row);
+            if (got != expected){
+                fprintf(stderr, "%s: row %d word %d: got %d expected %d\n",
+                        kernels[k].name, row, d, got, expected);
+                ret = 0;
+            }
+        }
+    }
+    num_checks++;
+    free(matches);
+    return ret;
+}
+
+/* Set up the constraints that "word" puts on row "row", starting from the
+ * cannot_be set of con, check the filters with them, and go on into the
+ * first BRANCHES matching words.
+ * Return 1 if all of the checks passed, and 0 otherwise.
+ */
+static int walk(int row, struct wordle *w, struct dictionary *dict,
+                char *word, struct constraints *con) {
+    struct constraints *child;
+    int found = 0;
+    int ret;
+
+    if (row >= w->num_rows){
+        return 1;
+    }
+    set_row_constraints(row, w, word, con);
+    ret = check_filters(dict, con, w, row);
+    for (int d = 0; d < dict_size(dict) && found < BRANCHES; d++){
+        if (match_constraints(dict_word(dict, d), con, w, row)){
+            child = init_constraints();
+            child->cannot_be = con->cannot_be;
+            ret &= walk(row + 1, w, dict, dict_word(dict, d), child);
+            free_constraints(child);
+            found++;
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    if(argc != 2){
+        fprintf(stderr, "Usage: test_filter <inputfile>\n");
+        exit(1);
+    }
+
+    FILE *fp = fopen(argv[1], "r");
+    if(fp == NULL){
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        exit(1);
+    }
+    struct wordle *w = create_wordle(fp);
+    fclose(fp);
+    struct dictionary *dict = read_list(DICT_FILE);
+
+    kernels[num_kernels].name = "scalar";
+    kernels[num_kernels++].filter = filter_scalar;
+#ifdef FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")){
+        kernels[num_kernels].name = "ssse3";
+        kernels[num_kernels++].filter = filter_ssse3;
+    }
+    if (__builtin_cpu_supports("avx2")){
+        kernels[num_kernels].name = "avx2";
+        kernels[num_kernels++].filter = filter_avx2;
+    }
+#endif
+
+    struct constraints *con = init_constraints();
+    int passed = walk(1, w, dict, w->grid[0], con);
+    if (passed){
+        printf("Test passed: %d kernels, %d constraint sets\n", num_kernels, num_checks);
+    }
+    else {
+        printf("Test failed\n");
+    }
+    free_constraints(con);
+    free_dictionary(dict);
+    free_wordle(w);
+    return passed ? 0 : 1;
+}
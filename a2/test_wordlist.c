@@ -3,7 +3,7 @@
 #include <string.h>
 #include "wordlist.h"
 
-/* A simple test that calls read_list to build the linked list of words
+/* A simple test that calls read_list to build the dictionary of words
  * and then prints it to stdout.
  * Try:
  *     test_wordlist examples/small_words5.txt
@@ -19,12 +19,11 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    struct node *dict = read_list(argv[1]);
+    struct dictionary *dict = read_list(argv[1]);
 
-    struct node *ptr = dict;
-    while(ptr != NULL) {
-        printf("%s\n", ptr->word);
-        ptr = ptr->next;
+    for(int i = 0; i < dict_size(dict); i++) {
+        printf("%s\n", dict_word(dict, i));
     }
+    free_dictionary(dict);
     return 0;
 }
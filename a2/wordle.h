@@ -36,7 +36,9 @@ struct solver_node {
 
 struct wordle *create_wordle(FILE *fp);
 struct solver_node *create_solver_node(struct constraints *c, char *word);
-void solve_subtree(int row, struct wordle *w,  struct node *dict, struct solver_node *parent);
+int match_constraints(char *word, struct constraints *con, struct wordle *w, int row);
+void set_row_constraints(int row, struct wordle *w, char *word, struct constraints *con);
+void solve_subtree(int row, struct wordle *w,  struct dictionary *dict, struct solver_node *parent);
 void print_paths(struct solver_node *node, char **path, int length, int num_rows);
 struct solver_node *init_solution_node(char *word);
 
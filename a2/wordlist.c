@@ -3,26 +3,57 @@
 #include <string.h>
 #include "wordlist.h"
 
+// the number of words the dictionary has room for at first
+#define INITIAL_CAPACITY 1024
 
-/* Read the words from a filename and return a linked list of the words.
- *   - The newline character at the end of the line must be removed from
- *     the word stored in the node.
- *   - You an assume you are working with Linux line endings ("\n").  You are
- *     welcome to also handle Window line endings ("\r\n"), but you are not
- *     required to, and we will test your code on files with Linux line endings.
- *   - The time complexity of adding one word to this list must be O(1)
- *     which means the linked list will have the words in reverse order
- *     compared to the order of the words in the file.
+/* Fill in the columns of dict from its words.
+ * The columns share one allocation, which columns[0] points to.
+ */
+static void build_columns(struct dictionary *dict) {
+    int padded = (dict->num_words + COLUMN_BLOCK - 1) / COLUMN_BLOCK * COLUMN_BLOCK;
+    unsigned char *letters = malloc(WORDLEN * padded + 1);
+
+    if (letters == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < WORDLEN; i++){
+        dict->columns[i] = letters + i * padded;
+        for (int d = 0; d < padded; d++){
+            dict->columns[i][d] = d < dict->num_words ? dict->words[d][i] - 'a'
+                                                      : COLUMN_PADDING;
+        }
+    }
+}
+
+/* Read the words from a filename and return a dictionary of the words.
+ *   - The newline character(s) at the end of the line are removed from
+ *     the word stored in the dictionary.
+ *   - The words are kept in the order of the file, in one array that is
+ *     doubled in size when it is full, so adding one word is O(1)
+ *     amortized.
+ *   - Reading stops at the first empty line.
+ *   - Every word must be WORDLEN lowercase letters.
+ *   - The columns are built once all of the words are read.
  *   - Do proper error checking of fopen, fclose, fgets
  */
-struct node *read_list(char *filename) {
-    struct node* curr_node = malloc(sizeof(*curr_node));
-    struct node* next_node;
-    struct node* ret = curr_node;
-    struct node* previous;
+struct dictionary *read_list(char *filename) {
+    struct dictionary *dict = malloc(sizeof(*dict));
     FILE *fp;
-    char buffer[SIZE];
-    char word[SIZE];
+    char line[MAXLINE];
+    char *ptr;
+
+    if (dict == NULL){
+        perror("malloc");
+        exit(1);
+    }
+    dict->num_words = 0;
+    dict->capacity = INITIAL_CAPACITY;
+    dict->words = malloc(dict->capacity * sizeof(*dict->words));
+    if (dict->words == NULL){
+        perror("malloc");
+        exit(1);
+    }
 
     // open file and check
     fp = fopen(filename, "r");
@@ -31,60 +62,73 @@ struct node *read_list(char *filename) {
         printf("Error opening file\n");
         exit(1);
     }
-    while (fgets(buffer, SIZE+1, fp) != NULL){
-        sscanf(buffer, "%s\n", word);
-        if (strlen(word) == 0){
+    while (fgets(line, MAXLINE, fp) != NULL){
+        // remove the newline character(s)
+        if(((ptr = strchr(line, '\r')) != NULL) ||
+           ((ptr = strchr(line, '\n')) != NULL)) {
+            *ptr = '\0';
+        }
+        if (strlen(line) == 0){
             break;
         }
         // error check
-        else if (strlen(word) != WORDLEN){
+        else if (strlen(line) != WORDLEN){
             printf("word length problem!\n");
             exit(1);
         }
-        // set word
-        strcpy(curr_node->word, word);
-        curr_node->word[WORDLEN] = '\0';
-        // init next node
-        next_node = malloc(sizeof(*next_node));
-        curr_node->next = next_node;
-        // record previous node
-        previous = curr_node;
-        curr_node = next_node;
-    }
-    if (previous != NULL){
-        // remove the last node which is not initialized and free it
-        free(curr_node);
-        previous->next = NULL;
+        // the filters and constraints index by letter - 'a'
+        for (int i = 0; i < WORDLEN; i++){
+            if (line[i] < 'a' || line[i] > 'z'){
+                printf("word letter problem!\n");
+                exit(1);
+            }
+        }
+        // make room for one more word
+        if (dict->num_words == dict->capacity){
+            dict->capacity *= 2;
+            dict->words = realloc(dict->words, dict->capacity * sizeof(*dict->words));
+            if (dict->words == NULL){
+                perror("realloc");
+                exit(1);
+            }
+        }
+        strcpy(dict->words[dict->num_words], line);
+        dict->num_words++;
     }
     // close file and check
     if (fclose(fp) != 0){
         printf("error closing the file!\n");
         exit(1);
     }
-    return ret;
+    build_columns(dict);
+    return dict;
 }
 
-/* Print the words in the linked-list list one per line
+/* Return the number of words in dict
  */
-void print_dictionary(struct node *list) {
-    struct node* curr_node = list;
-    // traverse the linked list
-    while (curr_node->next != NULL){
-        printf("%s\n", curr_node->word);
-        curr_node = curr_node->next;
-    }
+int dict_size(struct dictionary *dict) {
+    return dict->num_words;
 }
-/* Free all of the dynamically allocated memory in the dictionary list 
+
+/* Return word number index of dict, counting from 0 in the order of the
+ * file
+ */
+char *dict_word(struct dictionary *dict, int index) {
+    return dict->words[index];
+}
+
+/* Print the words in dict one per line
  */
-void free_dictionary(struct node *list) {
-    struct node* curr_node = list;
-    struct node* next_node = curr_node->next;
-    // free the linked list from root to end accordingly
-    while (curr_node->next != NULL){
-        free(curr_node);
-        curr_node = next_node;
-        next_node = curr_node->next;
+void print_dictionary(struct dictionary *dict) {
+    for (int i = 0; i < dict_size(dict); i++){
+        printf("%s\n", dict_word(dict, i));
     }
-    free(curr_node);
 }
 
+/* Free all of the dynamically allocated memory in the dictionary
+ */
+void free_dictionary(struct dictionary *dict) {
+    free(dict->columns[0]);
+    free(dict->words);
+    free(dict);
+}
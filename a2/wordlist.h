@@ -1,13 +1,31 @@
 #include "common.h"
 #define DICT_FILE "words5.txt"
 
-/* Used to store the dictionary list
+// the columns are padded to a multiple of this many words
+#define COLUMN_BLOCK 32
+// the letter code in the padding after the last word, which is no letter
+#define COLUMN_PADDING 31
+
+/* Used to store the dictionary
+ * - words is one contiguous array of num_words words in the order of the
+ *   file, each stored in SIZE chars including its '\0'
+ * - capacity is the number of words words has room for
+ * - columns[i] holds letter i of every word as a code from 0 ('a') to
+ *   25 ('z'), so a filter can load the same letter of many words at once.
+ *   Each column is padded with COLUMN_PADDING up to a multiple of
+ *   COLUMN_BLOCK words.
+ * Use dict_size and dict_word to go through the words by index, so that
+ * a scan of the dictionary is one linear sweep through memory.
  */
-struct node {
-    char word[SIZE];
-    struct node *next;
+struct dictionary {
+    char (*words)[SIZE];
+    int num_words;
+    int capacity;
+    unsigned char *columns[WORDLEN];
 };
 
-struct node *read_list(char *filename);
-void print_dictionary(struct node *list);
-void free_dictionary(struct node *list);
+struct dictionary *read_list(char *filename);
+int dict_size(struct dictionary *dict);
+char *dict_word(struct dictionary *dict, int index);
+void print_dictionary(struct dictionary *dict);
+void free_dictionary(struct dictionary *dict);